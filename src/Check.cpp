@@ -0,0 +1,141 @@
+#include "./game/Game.h"
+#include "./model/Model.h"
+
+#include <cmath>
+
+using namespace Backgammon;
+
+#define TOLERANCE 1e-5
+
+/*
+    @return the largest difference between the weights of a and b
+*/
+static double weight_difference(Model& a, Model& b) {
+    for (Model* model : {&a, &b}) {
+        if (model->backend == Backend::ANALYTIC) {
+            model->value_network->write(model->nn);
+        }
+    }
+    std::vector<RevGrad::Tensor> a_params = a.nn.get_params();
+    std::vector<RevGrad::Tensor> b_params = b.nn.get_params();
+    double difference = 0.0;
+    for (int k = 0; k < (int)a_params.size(); k++) {
+        for (int i = 0; i < a_params[k].size(); i++) {
+            difference = std::max(difference, (double)std::fabs(a_params[k].values()[i] - b_params[k].values()[i]));
+        }
+    }
+    return difference;
+}
+
+static bool report(const std::string& name, double difference) {
+    bool pass = difference <= TOLERANCE;
+    std::cout << (pass ? "PASS " : "FAIL ") << name << ": " << difference << std::endl;
+    return pass;
+}
+
+/*
+    Checks the hand written ValueNetwork against the RevGrad network on the positions
+    of seeded self-play, for a network with compiled sizes and one with run time sizes:
+    ValueNetwork::forward and step on dense and sparse inputs against predict and backward,
+    then Model::evaluate and TD(lambda) Model::update on every backend configuration
+
+    usage: ./Check [games]
+    @return 1 if a value or a weight differs by more than TOLERANCE
+*/
+int main(int argc, char** argv) {
+
+    int games = argc > 1 ? std::stoi(argv[1]) : 5;
+    uint64_t weights_seed = 1;
+    uint64_t positions_seed = 3;
+    bool pass = true;
+
+    for (int hidden_units : {80, 50}) {
+        std::cout << "Hidden units: " << hidden_units << std::endl;
+
+        // forward and step of one network, the positions are stepped towards 1/2
+        Model revgrad(hidden_units, weights_seed, Backend::REVGRAD);
+        Model dense(hidden_units, weights_seed, Backend::ANALYTIC);
+        Model sparse(hidden_units, weights_seed, Backend::ANALYTIC);
+        std::vector<Position> positions = dense.sample_positions(games, positions_seed);
+        std::vector<float> x(dense.value_network->inputs);
+        SparseInput sparse_x;
+        double dense_difference = 0.0;
+        double sparse_difference = 0.0;
+        for (const Position& position : positions) {
+            dense.encode(position, x.data(), 1);
+            sparse.encode(position, sparse_x);
+            RevGrad::Arena::Scope scope(revgrad.arena);
+            RevGrad::Tensor prediction = revgrad.predict(position);
+            float value = prediction.values()[0];
+            float dense_value = dense.value_network->forward(x.data());
+            float sparse_value = sparse.value_network->forward(sparse_x);
+            dense_difference = std::max(dense_difference, (double)std::fabs(dense_value - value));
+            sparse_difference = std::max(sparse_difference, (double)std::fabs(sparse_value - value));
+            std::vector<RevGrad::Tensor> params = revgrad.nn.get_params();
+            for (auto& param : params) {
+                std::fill(param.grads().begin(), param.grads().end(), 0.0f);
+            }
+            prediction.backward();
+            for (auto& param : params) {
+                for (int i = 0; i < param.size(); i++) {
+                    param.values()[i] += 0.1f * (0.5f - value) * param.grads()[i];
+                }
+            }
+            dense.value_network->step(x.data(), 0.1f * (0.5f - dense_value));
+            sparse.value_network->step(sparse_x, 0.1f * (0.5f - sparse_value));
+        }
+        pass &= report("forward dense", dense_difference);
+        pass &= report("forward sparse", sparse_difference);
+        pass &= report("step dense", weight_difference(revgrad, dense));
+        pass &= report("step sparse", weight_difference(revgrad, sparse));
+
+        // self-play with TD(lambda), every model updates on the moves the REVGRAD model chooses
+        std::vector<std::unique_ptr<Model>> models;
+        std::vector<std::string> names = {"revgrad", "dense", "sparse", "incremental"};
+        for (int i = 0; i < (int)names.size(); i++) {
+            models.push_back(std::make_unique<Model>(hidden_units, weights_seed, i ? Backend::ANALYTIC : Backend::REVGRAD));
+            models[i]->sparse = i >= 2;
+            models[i]->incremental = i >= 3;
+        }
+        std::vector<double> value_differences(models.size(), 0.0);
+        RevGrad::Random rng(positions_seed);
+        std::unique_ptr<AfterstateList> afterstates = std::make_unique<AfterstateList>();
+        for (int game = 0; game < games; game++) {
+            for (auto& model : models) {
+                model->new_game();
+            }
+            Position position;
+            position.turn = rng.uniform(2);
+            float reward;
+            while (!Model::game_over(position, reward)) {
+                int first = rng.uniform(6) + 1;
+                int second = rng.uniform(6) + 1;
+                position.generate_afterstates(first, second, *afterstates);
+                if (afterstates->empty()) {
+                    position.turn = !position.turn;
+                    continue;
+                }
+                int index = models[0]->choose_move(position, Dice(), *afterstates);
+                std::vector<float> values(models[0]->values.begin(), models[0]->values.begin() + afterstates->size);
+                for (int i = 1; i < (int)models.size(); i++) {
+                    models[i]->choose_move(position, Dice(), *afterstates);
+                    for (int j = 0; j < afterstates->size; j++) {
+                        value_differences[i] = std::max(value_differences[i], (double)std::fabs(models[i]->values[j] - values[j]));
+                    }
+                }
+                Position next = (*afterstates)[index].position;
+                for (auto& model : models) {
+                    model->update(position, next);
+                }
+                position = next;
+            }
+        }
+        for (int i = 1; i < (int)models.size(); i++) {
+            pass &= report("evaluate " + names[i], value_differences[i]);
+            pass &= report("update " + names[i], weight_difference(*models[0], *models[i]));
+        }
+    }
+
+    std::cout << (pass ? "All checks passed" : "Some checks failed") << std::endl;
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+#include "./game/Game.h"
+#include "./model/Model.h"
+
+#include <chrono>
+#include <cmath>
+
+using namespace Backgammon;
+
+/*
+    Reports how far the QUANTIZED backend's evaluations drift from fp32
+    on the afterstates of positions from seeded self-play
+
+    usage: ./Drift [weights file] [games]
+*/
+int main(int argc, char** argv) {
+
+    std::string filename = argc > 1 ? argv[1] : "";
+    int games = argc > 2 ? std::stoi(argv[2]) : 200;
+    int hidden_units = 80;
+
+    // Seeds, the test positions come from other games than the calibration positions
+    uint64_t weights_seed = 1;
+    uint64_t positions_seed = 3;
+
+    // Model
+    Model model(hidden_units, weights_seed, Backend::QUANTIZED);
+    if (!filename.empty()) {
+        model.load(filename);
+        std::cout << "Loaded weights from file: " << filename << std::endl;
+    } else {
+        std::cout << "Using random weights" << std::endl;
+    }
+    QuantizedNetwork& quantized_network = model.quantized();
+
+    // Positions
+    std::vector<Position> positions = model.sample_positions(games, positions_seed);
+    std::vector<std::array<int, 2>> rolls;
+    RevGrad::Random rng(positions_seed);
+    for (int i = 0; i < (int)positions.size(); i++) {
+        rolls.push_back({rng.uniform(6) + 1, rng.uniform(6) + 1});
+    }
+
+    // Evaluate, only the networks are timed, not the encoding
+    std::unique_ptr<AfterstateList> afterstates = std::make_unique<AfterstateList>();
+    std::vector<SparseInput> inputs(MAX_AFTERSTATES);
+    std::vector<float> fp32(MAX_AFTERSTATES);
+    std::vector<float> quantized(MAX_AFTERSTATES);
+    double fp32_seconds = 0.0;
+    double quantized_seconds = 0.0;
+    double total_drift = 0.0;
+    double max_drift = 0.0;
+    long evaluations = 0;
+    int agreements = 0;
+    int choices = 0;
+    for (int i = 0; i < (int)positions.size(); i++) {
+        Position& position = positions[i];
+        position.generate_afterstates(rolls[i][0], rolls[i][1], *afterstates);
+        if (afterstates->empty()) {
+            continue;
+        }
+        int n = afterstates->size;
+        for (int j = 0; j < n; j++) {
+            model.encode((*afterstates)[j].position, inputs[j]);
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int j = 0; j < n; j++) {
+            fp32[j] = model.value_network->forward(inputs[j]);
+        }
+        auto middle = std::chrono::steady_clock::now();
+        for (int j = 0; j < n; j++) {
+            quantized[j] = quantized_network.forward(inputs[j]);
+        }
+        auto end = std::chrono::steady_clock::now();
+        fp32_seconds += std::chrono::duration<double>(middle - start).count();
+        quantized_seconds += std::chrono::duration<double>(end - middle).count();
+        int fp32_index = 0;
+        int quantized_index = 0;
+        float sign = position.turn == WHITE ? 1.0f : -1.0f;
+        for (int j = 0; j < n; j++) {
+            double drift = std::fabs(fp32[j] - quantized[j]);
+            total_drift += drift;
+            max_drift = std::max(max_drift, drift);
+            if (sign * fp32[j] > sign * fp32[fp32_index]) {
+                fp32_index = j;
+            }
+            if (sign * quantized[j] > sign * quantized[quantized_index]) {
+                quantized_index = j;
+            }
+        }
+        evaluations += n;
+        agreements += fp32_index == quantized_index;
+        choices++;
+    }
+
+    std::cout << "Positions: " << choices << ", afterstates: " << evaluations << std::endl;
+    std::cout << "Mean drift: " << total_drift / evaluations << std::endl;
+    std::cout << "Max drift: " << max_drift << std::endl;
+    std::cout << "Same move chosen: " << 100.0 * agreements / choices << "%" << std::endl;
+    std::cout << "fp32 evaluations/s: " << evaluations / fp32_seconds << std::endl;
+    std::cout << "Quantized evaluations/s: " << evaluations / quantized_seconds << std::endl;
+    int fp32_bytes = 0;
+    for (auto param : model.nn.get_params()) {
+        fp32_bytes += param.size() * sizeof(float);
+    }
+    std::cout << "Saturated weights: " << quantized_network.saturated << std::endl;
+    std::cout << "Weights: " 
+        << fp32_bytes << " bytes fp32, " 
+        << quantized_network.bytes() << " bytes quantized" << std::endl;
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "./game/Game.h"
+#include "./game/Observer.h"
 #include "./player/Player.h"
 #include "./player/Human.h"
 #include "./player/AI.h"
@@ -96,9 +97,9 @@ int main() {
     for (int i = 1; i <= games; i++) {
         game.play();
 
-        if ((int)game.state.made.size() >= 200) {
+        if ((int)game.history.size() >= 200) {
             std::cout << "Game nr. " << i << std::endl;
-            std::cout << "Nr. of moves made: " << (int)game.state.made.size() << std::endl;
+            std::cout << "Nr. of moves made: " << (int)game.history.size() << std::endl;
         }
     }
 
@@ -120,7 +121,9 @@ int main() {
     // Game
     Game game(
         std::make_shared<Human>("WHITE"), 
-        std::make_shared<AI>("BLACK", model)
+        std::make_shared<AI>("BLACK", model),
+        std::make_shared<ConsoleObserver>(),
+        RevGrad::Random::entropy()
     );
 
     game.play();
@@ -0,0 +1,222 @@
+#include "Gemm.h"
+
+// columns of C kept in L1 per block
+#define GEMM_NC 256
+// rows of B kept in L2 per block
+#define GEMM_KC 256
+// below this many columns B is packed transposed and C is computed with dot products
+#define GEMM_SMALL_N 16
+// multiply-adds before the kernel is split over threads
+#define GEMM_PARALLEL_WORK (1 << 20)
+
+namespace RevGrad {
+    namespace Kernel {
+        int threads = omp_get_max_threads();
+
+        static thread_local std::vector<float> scratch;
+
+        static float* scratch_buffer(int size) {
+            if ((int)scratch.size() < size) {
+                scratch.resize(size);
+            }
+            return scratch.data();
+        }
+
+        static bool parallel(int m, int n, int k) {
+            return threads > 1 && (long long)m * n * k >= GEMM_PARALLEL_WORK;
+        }
+
+        static void scale(int m, int n, float beta, float* c, int ldc) {
+            if (beta == 1.0f) {
+                return;
+            }
+            for (int i = 0; i < m; i++) {
+                float* ci = c + i * ldc;
+                if (beta == 0.0f) {
+                    std::fill(ci, ci + n, 0.0f);
+                } else {
+                    #pragma omp simd
+                    for (int j = 0; j < n; j++) {
+                        ci[j] *= beta;
+                    }
+                }
+            }
+        }
+
+        /*
+            C += alpha * A * B^T, every entry is a dot product of two contiguous rows
+        */
+        static void gemm_nt(int m, int n, int k, float alpha, const float* a, int lda, const float* b, int ldb, float* c, int ldc) {
+            #pragma omp parallel for num_threads(threads) if (parallel(m, n, k))
+            for (int i0 = 0; i0 < m; i0 += 4) {
+                if (i0 + 4 <= m) {
+                    // four rows of A share every row of B that is loaded
+                    const float* a0 = a + (i0 + 0) * lda;
+                    const float* a1 = a + (i0 + 1) * lda;
+                    const float* a2 = a + (i0 + 2) * lda;
+                    const float* a3 = a + (i0 + 3) * lda;
+                    for (int j = 0; j < n; j++) {
+                        const float* bj = b + j * ldb;
+                        float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+                        #pragma omp simd reduction(+:s0, s1, s2, s3)
+                        for (int p = 0; p < k; p++) {
+                            s0 += a0[p] * bj[p];
+                            s1 += a1[p] * bj[p];
+                            s2 += a2[p] * bj[p];
+                            s3 += a3[p] * bj[p];
+                        }
+                        c[(i0 + 0) * ldc + j] += alpha * s0;
+                        c[(i0 + 1) * ldc + j] += alpha * s1;
+                        c[(i0 + 2) * ldc + j] += alpha * s2;
+                        c[(i0 + 3) * ldc + j] += alpha * s3;
+                    }
+                    continue;
+                }
+                for (int i = i0; i < m; i++) {
+                    const float* ai = a + i * lda;
+                    for (int j = 0; j < n; j++) {
+                        const float* bj = b + j * ldb;
+                        float s = 0.0f;
+                        #pragma omp simd reduction(+:s)
+                        for (int p = 0; p < k; p++) {
+                            s += ai[p] * bj[p];
+                        }
+                        c[i * ldc + j] += alpha * s;
+                    }
+                }
+            }
+        }
+
+        /*
+            C += alpha * A * B, rows of B are streamed into blocks of C
+        */
+        static void gemm_nn(int m, int n, int k, float alpha, const float* a, int lda, const float* b, int ldb, float* c, int ldc) {
+            if (n < GEMM_SMALL_N) {
+                float* bt = scratch_buffer(n * k);
+                for (int p = 0; p < k; p++) {
+                    for (int j = 0; j < n; j++) {
+                        bt[j * k + p] = b[p * ldb + j];
+                    }
+                }
+                gemm_nt(m, n, k, alpha, a, lda, bt, k, c, ldc);
+                return;
+            }
+            #pragma omp parallel for num_threads(threads) if (parallel(m, n, k))
+            for (int i0 = 0; i0 < m; i0 += 4) {
+                int rows = std::min(4, m - i0);
+                for (int j0 = 0; j0 < n; j0 += GEMM_NC) {
+                    int j1 = std::min(n, j0 + GEMM_NC);
+                    for (int p0 = 0; p0 < k; p0 += GEMM_KC) {
+                        int p1 = std::min(k, p0 + GEMM_KC);
+                        if (rows == 4) {
+                            // four rows of C share every row of B that is loaded
+                            float* c0 = c + (i0 + 0) * ldc;
+                            float* c1 = c + (i0 + 1) * ldc;
+                            float* c2 = c + (i0 + 2) * ldc;
+                            float* c3 = c + (i0 + 3) * ldc;
+                            for (int p = p0; p < p1; p++) {
+                                float a0 = alpha * a[(i0 + 0) * lda + p];
+                                float a1 = alpha * a[(i0 + 1) * lda + p];
+                                float a2 = alpha * a[(i0 + 2) * lda + p];
+                                float a3 = alpha * a[(i0 + 3) * lda + p];
+                                const float* bp = b + p * ldb;
+                                #pragma omp simd
+                                for (int j = j0; j < j1; j++) {
+                                    c0[j] += a0 * bp[j];
+                                    c1[j] += a1 * bp[j];
+                                    c2[j] += a2 * bp[j];
+                                    c3[j] += a3 * bp[j];
+                                }
+                            }
+                            continue;
+                        }
+                        for (int i = i0; i < i0 + rows; i++) {
+                            float* ci = c + i * ldc;
+                            for (int p = p0; p < p1; p++) {
+                                float ai = alpha * a[i * lda + p];
+                                const float* bp = b + p * ldb;
+                                #pragma omp simd
+                                for (int j = j0; j < j1; j++) {
+                                    ci[j] += ai * bp[j];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        /*
+            C += alpha * A^T * B, a sum of rank one updates, one per row of A and B
+        */
+        static void gemm_tn(int m, int n, int k, float alpha, const float* a, int lda, const float* b, int ldb, float* c, int ldc) {
+            if (n < GEMM_SMALL_N) {
+                // accumulate C^T so the inner loop runs along the rows of A
+                float* ct = scratch_buffer(n * m);
+                std::fill(ct, ct + n * m, 0.0f);
+                for (int p = 0; p < k; p++) {
+                    const float* ap = a + p * lda;
+                    for (int j = 0; j < n; j++) {
+                        float bpj = alpha * b[p * ldb + j];
+                        float* ctj = ct + j * m;
+                        #pragma omp simd
+                        for (int i = 0; i < m; i++) {
+                            ctj[i] += ap[i] * bpj;
+                        }
+                    }
+                }
+                for (int i = 0; i < m; i++) {
+                    for (int j = 0; j < n; j++) {
+                        c[i * ldc + j] += ct[j * m + i];
+                    }
+                }
+                return;
+            }
+            #pragma omp parallel for num_threads(threads) if (parallel(m, n, k))
+            for (int i = 0; i < m; i++) {
+                float* ci = c + i * ldc;
+                for (int j0 = 0; j0 < n; j0 += GEMM_NC) {
+                    int j1 = std::min(n, j0 + GEMM_NC);
+                    for (int p = 0; p < k; p++) {
+                        float ai = alpha * a[p * lda + i];
+                        const float* bp = b + p * ldb;
+                        #pragma omp simd
+                        for (int j = j0; j < j1; j++) {
+                            ci[j] += ai * bp[j];
+                        }
+                    }
+                }
+            }
+        }
+
+        void gemm(
+            bool transpose_a, bool transpose_b,
+            int m, int n, int k,
+            float alpha, const float* a, int lda,
+            const float* b, int ldb,
+            float beta, float* c, int ldc
+        ) {
+            scale(m, n, beta, c, ldc);
+            if (m == 0 || n == 0 || k == 0 || alpha == 0.0f) {
+                return;
+            }
+            if (!transpose_a && !transpose_b) {
+                gemm_nn(m, n, k, alpha, a, lda, b, ldb, c, ldc);
+            } else if (!transpose_a && transpose_b) {
+                gemm_nt(m, n, k, alpha, a, lda, b, ldb, c, ldc);
+            } else if (transpose_a && !transpose_b) {
+                gemm_tn(m, n, k, alpha, a, lda, b, ldb, c, ldc);
+            } else {
+                for (int i = 0; i < m; i++) {
+                    for (int j = 0; j < n; j++) {
+                        float s = 0.0f;
+                        for (int p = 0; p < k; p++) {
+                            s += a[p * lda + i] * b[j * ldb + p];
+                        }
+                        c[i * ldc + j] += alpha * s;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef REVGRAD_GEMM_H
+#define REVGRAD_GEMM_H
+
+#include <algorithm>
+#include <vector>
+#include <omp.h>
+
+namespace RevGrad {
+    namespace Kernel {
+        /*
+            Max number of OpenMP threads a kernel may use, set it to 1 when
+            the caller already runs one kernel per thread
+        */
+        extern int threads;
+
+        /*
+            C = alpha * op(A) * op(B) + beta * C with row major matrices,
+            op(A) is m x k, op(B) is k x n and C is m x n.
+            op(X) is X, or X transposed when transpose_x is set
+        */
+        void gemm(
+            bool transpose_a, bool transpose_b,
+            int m, int n, int k,
+            float alpha, const float* a, int lda,
+            const float* b, int ldb,
+            float beta, float* c, int ldc
+        );
+    }
+}
+
+#endif
@@ -0,0 +1,26 @@
+#include "Math.h"
+
+namespace RevGrad {
+    namespace Kernel {
+        void exp(const float* x, float* y, int n) {
+            #pragma omp simd
+            for (int i = 0; i < n; i++) {
+                y[i] = exp(x[i]);
+            }
+        }
+
+        void log(const float* x, float* y, int n) {
+            #pragma omp simd
+            for (int i = 0; i < n; i++) {
+                y[i] = log(x[i]);
+            }
+        }
+
+        void sigmoid(const float* x, float* y, int n) {
+            #pragma omp simd
+            for (int i = 0; i < n; i++) {
+                y[i] = sigmoid(x[i]);
+            }
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef REVGRAD_MATH_H
+#define REVGRAD_MATH_H
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+namespace RevGrad {
+    namespace Kernel {
+        /*
+            Branch free polynomial versions of expf and logf, written so loops over them vectorize.
+            exp: range reduction x = n * ln(2) + r with |r| <= ln(2) / 2, then a degree 6 polynomial.
+                 Relative error below 2e-7 (about 2 ulp) on [-87, 88], 
+                 the input is clamped to that range so no inf or nan comes out.
+            log: x = m * 2^e with sqrt(1/2) <= m < sqrt(2), then a degree 9 polynomial in m - 1.
+                 Within 1 ulp of log(x) for normal positive x, the absolute error grows with |log(x)|
+                 and is below 1e-7 on [0.25, 4],
+                 zero, negative and denormal inputs are not handled.
+        */
+        #define EXP_MIN -87.0f
+        #define EXP_MAX 88.0f
+
+        inline float bits_to_float(int32_t bits) {
+            float x;
+            std::memcpy(&x, &bits, sizeof(x));
+            return x;
+        }
+
+        inline int32_t float_to_bits(float x) {
+            int32_t bits;
+            std::memcpy(&bits, &x, sizeof(bits));
+            return bits;
+        }
+
+        inline float exp(float x) {
+            x = std::min(std::max(x, EXP_MIN), EXP_MAX);
+            // rounds to the nearest integer, 1.5 * 2^23 leaves no fraction bits
+            float n = (x * 1.44269504f + 12582912.0f) - 12582912.0f;
+            // ln(2) split in two so n * 0.693359375f is exact
+            float r = x - n * 0.693359375f + n * 2.12194440e-4f;
+            float p = 1.9875691500e-4f;
+            p = p * r + 1.3981999507e-3f;
+            p = p * r + 8.3334519073e-3f;
+            p = p * r + 4.1665795894e-2f;
+            p = p * r + 1.6666665459e-1f;
+            p = p * r + 5.0000001201e-1f;
+            p = p * r * r + r + 1.0f;
+            return p * bits_to_float(((int32_t)n + 127) << 23);
+        }
+
+        inline float log(float x) {
+            int32_t bits = float_to_bits(x);
+            // exponent and mantissa with the mantissa moved to [sqrt(1/2), sqrt(2))
+            int32_t shifted = bits - 0x3f3504f3;
+            float e = (float)(shifted >> 23);
+            float m = bits_to_float((shifted & 0x007fffff) + 0x3f3504f3) - 1.0f;
+            float m2 = m * m;
+            float p = 7.0376836292e-2f;
+            p = p * m - 1.1514610310e-1f;
+            p = p * m + 1.1676998740e-1f;
+            p = p * m - 1.2420140846e-1f;
+            p = p * m + 1.4249322787e-1f;
+            p = p * m - 1.6668057665e-1f;
+            p = p * m + 2.0000714765e-1f;
+            p = p * m - 2.4999993993e-1f;
+            p = p * m + 3.3333331174e-1f;
+            p = p * m * m2;
+            p += e * -2.12194440e-4f - 0.5f * m2;
+            return m + p + e * 0.693359375f;
+        }
+
+        inline float sigmoid(float x) {
+            return 1.0f / (1.0f + exp(-x));
+        }
+
+        /*
+            y[i] = f(x[i]) for i < n, y may be x
+        */
+        void exp(const float* x, float* y, int n);
+        void log(const float* x, float* y, int n);
+        void sigmoid(const float* x, float* y, int n);
+    }
+}
+
+#endif
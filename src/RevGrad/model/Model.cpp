@@ -17,7 +17,7 @@ namespace RevGrad {
         std::ofstream file(filename);
         assert(file.is_open());
         for (const auto& param : parameters) {
-            std::vector<float> values = param.values();
+            const Values& values = param.values();
             int size = (int)values.size();
             file << size << "\n";
             for (int i = 0; i < size; i++) {
@@ -41,7 +41,7 @@ namespace RevGrad {
             int size = std::stoi(line);
             assert(size == (int)parameters[index].values().size());
             assert(std::getline(file, line));
-            std::vector<float> values;
+            Values values;
             std::stringstream ss(line);
             std::string s;
             while (std::getline(ss, s, ',')) {
@@ -54,17 +54,24 @@ namespace RevGrad {
         file.close();
     }
 
-    Linear::Linear(Model* parent_model, int in_features, int out_features) 
+    Linear::Linear(
+        Model* parent_model, 
+        int in_features, 
+        int out_features, 
+        Random& rng, 
+        Activation activation
+    ) 
         : in_features(in_features),
           out_features(out_features),
-          weights(Tensor::random(Shape({out_features, in_features}), in_features)), 
-          bias(Tensor(Shape({out_features, 1})))
+          weights(Tensor::random(Shape({out_features, in_features}), in_features, rng)), 
+          bias(Tensor(Shape({out_features, 1}))),
+          activation(activation)
     {
         parent_model->parameters.push_back(weights);
         parent_model->parameters.push_back(bias);
     }
 
     Tensor Linear::forward(Tensor x) {
-        return Tensor::matmul(weights, x) + bias;
+        return Tensor::linear(weights, x, bias, activation);
     }
 }
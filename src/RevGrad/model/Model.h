@@ -24,8 +24,15 @@ namespace RevGrad {
         int out_features;
         Tensor weights;
         Tensor bias;
+        Activation activation;
         Linear() {}
-        Linear(Model* parent_model, int in_features, int out_features);
+        Linear(
+            Model* parent_model, 
+            int in_features, 
+            int out_features, 
+            Random& rng, 
+            Activation activation = Activation::NONE
+        );
         /*
             @param x tensor of shape (features, batch size)
         */
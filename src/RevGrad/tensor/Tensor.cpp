@@ -1,8 +1,10 @@
 #include "Tensor.h"
+#include "../kernel/Gemm.h"
+#include "../kernel/Math.h"
 
 namespace RevGrad {
     namespace ViewUtill {
-        int shape_size(Shape shape) {
+        int shape_size(const Shape& shape) {
             return std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<int>());
         }
 
@@ -69,12 +71,37 @@ namespace RevGrad {
         }
     }
 
+    thread_local bool NoGrad::enabled = false;
+
+    NoGrad::NoGrad() : previous(enabled) { enabled = true; }
+    NoGrad::~NoGrad() { enabled = previous; }
+
+    thread_local std::vector<Tensor> Tape::tensors;
+    thread_local uint64_t Tape::epoch = 0;
+
+    void Tape::record(const Tensor& tensor) {
+        assert(tensor.data()->tape_index == -1);
+        tensor.data()->tape_index = tensors.size();
+        tensors.push_back(tensor);
+    }
+
+    void Tape::rewind(int size) {
+        for (int i = size; i < (int)tensors.size(); i++) {
+            tensors[i].data()->tape_index = -1;
+        }
+        tensors.resize(size);
+    }
+
+    void Tape::clear() {
+        rewind(0);
+    }
+
     Node::Node(float value) 
         : shape(Shape(1, 1))
     {
         values = Values(1, value);
         strides = ViewUtill::strides_from_shape(shape);
-        grads = Gradients(1);
+        grads = Gradients(NoGrad::enabled ? 0 : 1);
     }
 
     Node::Node(Shape shape, float value) 
@@ -83,123 +110,212 @@ namespace RevGrad {
     {
         int size = ViewUtill::shape_size(shape);
         values = Values(size, value);
-        grads = Gradients(size);
+        grads = Gradients(NoGrad::enabled ? 0 : size);
     }
 
     Node::Node(Shape shape, Values values) 
         : values(values),
           shape(shape), 
           strides(ViewUtill::strides_from_shape(shape)),
-          grads(Gradients((int)values.size()))
+          grads(Gradients(NoGrad::enabled ? 0 : (int)values.size()))
     {
         assert(ViewUtill::shape_size(shape) == (int)values.size());
     }
 
     namespace TensorUtill {
-        Tensor addition(const Tensor& u, const Tensor& v) {
+        /*
+            Where an operand of an element-wise op sits relative to the result, with the result
+            seen as rows x cols (cols being its last dimension): element (i, j) of the operand
+            is at i * row_stride + j * col_stride. Same shapes, scalars and a broadcast row or
+            column all fit this, anything else takes the generic path
+        */
+        struct Layout {
+            int row_stride;
+            int col_stride;
+        };
+
+        bool layout(const Tensor& x, const Tensor& w, Layout& layout) {
+            if (w.shape().empty() || w.size() == 0) {
+                return false;
+            }
+            int cols = w.shape().back();
+            int rows = w.size() / cols;
+            if (x.size() == w.size()) {
+                layout = {cols, 1};
+            } else if (x.size() == 1) {
+                layout = {0, 0};
+            } else if (x.shape().back() == cols && x.size() == cols) {
+                layout = {0, 1};
+            } else if (x.shape().back() == 1 && x.size() == rows) {
+                layout = {1, 0};
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        template <class Op>
+        Tensor elementwise(const Tensor& u, const Tensor& v, Op op) {
             Shape shape = ViewUtill::broadcast_shape(u.shape(), v.shape());
             Tensor w(shape);
-            for (int i = 0; i < w.size(); i++) {
-                Indices indices = ViewUtill::unravel(i, w.shape(), w.strides());
-                float u_value = u.value(ViewUtill::reshape_indices(indices, u.shape()));
-                float v_value = v.value(ViewUtill::reshape_indices(indices, v.shape()));
-                w.values()[i] = u_value + v_value;
+            Layout u_layout, v_layout;
+            if (layout(u, w, u_layout) && layout(v, w, v_layout)) {
+                int cols = shape.back();
+                int rows = w.size() / cols;
+                for (int i = 0; i < rows; i++) {
+                    const float* a = u.values().data() + i * u_layout.row_stride;
+                    const float* b = v.values().data() + i * v_layout.row_stride;
+                    float* c = w.values().data() + i * cols;
+                    if (u_layout.col_stride && v_layout.col_stride) {
+                        #pragma omp simd
+                        for (int j = 0; j < cols; j++) {
+                            c[j] = op(a[j], b[j]);
+                        }
+                    } else if (u_layout.col_stride) {
+                        float b_value = b[0];
+                        #pragma omp simd
+                        for (int j = 0; j < cols; j++) {
+                            c[j] = op(a[j], b_value);
+                        }
+                    } else if (v_layout.col_stride) {
+                        float a_value = a[0];
+                        #pragma omp simd
+                        for (int j = 0; j < cols; j++) {
+                            c[j] = op(a_value, b[j]);
+                        }
+                    } else {
+                        std::fill(c, c + cols, op(a[0], b[0]));
+                    }
+                }
+            } else {
+                for (int i = 0; i < w.size(); i++) {
+                    Indices indices = ViewUtill::unravel(i, w.shape(), w.strides());
+                    float u_value = u.value(ViewUtill::reshape_indices(indices, u.shape()));
+                    float v_value = v.value(ViewUtill::reshape_indices(indices, v.shape()));
+                    w.values()[i] = op(u_value, v_value);
+                }
             }
             w.add_edge(u), w.add_edge(v);
             return w;
         }
 
-        void addition_backward_fn(const Tensor& w) {
+        /*
+            Adds f(j) for j in [0, cols) to row i of grads,
+            summing the row first when the operand was broadcast along it
+        */
+        template <class F>
+        void accumulate(float* grads, const Layout& layout, int i, int cols, F f) {
+            float* g = grads + i * layout.row_stride;
+            if (layout.col_stride) {
+                #pragma omp simd
+                for (int j = 0; j < cols; j++) {
+                    g[j] += f(j);
+                }
+            } else {
+                float sum = 0.0f;
+                #pragma omp simd reduction(+:sum)
+                for (int j = 0; j < cols; j++) {
+                    sum += f(j);
+                }
+                g[0] += sum;
+            }
+        }
+
+        /*
+            du and dv map (gradient of w, value of u, value of v) 
+            to the gradient flowing into u and v
+        */
+        template <class DU, class DV>
+        void elementwise_backward(const Tensor& w, DU du, DV dv) {
             assert((int)w.edges().size() == 2);
             Tensor u = w.edges()[0];
             Tensor v = w.edges()[1];
+            bool u_grads = !u.grads().empty();
+            bool v_grads = !v.grads().empty();
+            Layout u_layout, v_layout;
+            if (layout(u, w, u_layout) && layout(v, w, v_layout)) {
+                int cols = w.shape().back();
+                int rows = w.size() / cols;
+                int u_col = u_layout.col_stride;
+                int v_col = v_layout.col_stride;
+                for (int i = 0; i < rows; i++) {
+                    const float* g = w.grads().data() + i * cols;
+                    const float* a = u.values().data() + i * u_layout.row_stride;
+                    const float* b = v.values().data() + i * v_layout.row_stride;
+                    if (u_grads) {
+                        accumulate(u.grads().data(), u_layout, i, cols, [&] (int j) {
+                            return du(g[j], a[j * u_col], b[j * v_col]);
+                        });
+                    }
+                    if (v_grads) {
+                        accumulate(v.grads().data(), v_layout, i, cols, [&] (int j) {
+                            return dv(g[j], a[j * u_col], b[j * v_col]);
+                        });
+                    }
+                }
+                return;
+            }
             for (int i = 0; i < w.size(); i++) {
                 Indices indices = ViewUtill::unravel(i, w.shape(), w.strides());
                 Indices u_indices = ViewUtill::reshape_indices(indices, u.shape());
                 Indices v_indices = ViewUtill::reshape_indices(indices, v.shape());
-                u.grad(u_indices) += w.grads()[i];
-                v.grad(v_indices) += w.grads()[i];
+                float u_value = u.value(u_indices);
+                float v_value = v.value(v_indices);
+                if (u_grads) {
+                    u.grad(u_indices) += du(w.grads()[i], u_value, v_value);
+                }
+                if (v_grads) {
+                    v.grad(v_indices) += dv(w.grads()[i], u_value, v_value);
+                }
             }
         }
 
+        Tensor addition(const Tensor& u, const Tensor& v) {
+            return elementwise(u, v, [] (float a, float b) { return a + b; });
+        }
+
+        void addition_backward_fn(const Tensor& w) {
+            elementwise_backward(
+                w,
+                [] (float g, float a, float b) { return g; },
+                [] (float g, float a, float b) { return g; }
+            );
+        }
+
         Tensor subtraction(const Tensor& u, const Tensor& v) {
-            Shape shape = ViewUtill::broadcast_shape(u.shape(), v.shape());
-            Tensor w(shape);
-            for (int i = 0; i < w.size(); i++) {
-                Indices indices = ViewUtill::unravel(i, w.shape(), w.strides());
-                float u_value = u.value(ViewUtill::reshape_indices(indices, u.shape()));
-                float v_value = v.value(ViewUtill::reshape_indices(indices, v.shape()));
-                w.values()[i] = u_value - v_value;
-            }
-            w.add_edge(u), w.add_edge(v);
-            return w;
+            return elementwise(u, v, [] (float a, float b) { return a - b; });
         }
 
         void subtraction_backward_fn(const Tensor& w) {
-            assert((int)w.edges().size() == 2);
-            Tensor u = w.edges()[0];
-            Tensor v = w.edges()[1];
-            for (int i = 0; i < w.size(); i++) {
-                Indices indices = ViewUtill::unravel(i, w.shape(), w.strides());
-                Indices u_indices = ViewUtill::reshape_indices(indices, u.shape());
-                Indices v_indices = ViewUtill::reshape_indices(indices, v.shape());
-                u.grad(u_indices) += w.grads()[i];
-                v.grad(v_indices) -= w.grads()[i];
-            }
+            elementwise_backward(
+                w,
+                [] (float g, float a, float b) { return g; },
+                [] (float g, float a, float b) { return -g; }
+            );
         }
 
         Tensor multiplication(const Tensor& u, const Tensor& v) {
-            Shape shape = ViewUtill::broadcast_shape(u.shape(), v.shape());
-            Tensor w(shape);
-            for (int i = 0; i < w.size(); i++) {
-                Indices indices = ViewUtill::unravel(i, w.shape(), w.strides());
-                float u_value = u.value(ViewUtill::reshape_indices(indices, u.shape()));
-                float v_value = v.value(ViewUtill::reshape_indices(indices, v.shape()));
-                w.values()[i] = u_value * v_value;
-            }
-            w.add_edge(u), w.add_edge(v);
-            return w;
+            return elementwise(u, v, [] (float a, float b) { return a * b; });
         }
 
         void multiplication_backward_fn(const Tensor& w) {
-            assert((int)w.edges().size() == 2);
-            Tensor u = w.edges()[0];
-            Tensor v = w.edges()[1];
-            for (int i = 0; i < w.size(); i++) {
-                Indices indices = ViewUtill::unravel(i, w.shape(), w.strides());
-                Indices u_indices = ViewUtill::reshape_indices(indices, u.shape());
-                Indices v_indices = ViewUtill::reshape_indices(indices, v.shape());
-                u.grad(u_indices) += w.grads()[i] * v.value(v_indices);
-                v.grad(v_indices) += w.grads()[i] * u.value(u_indices);
-            }
+            elementwise_backward(
+                w,
+                [] (float g, float a, float b) { return g * b; },
+                [] (float g, float a, float b) { return g * a; }
+            );
         }
 
         Tensor division(const Tensor& u, const Tensor& v) {
-            Shape shape = ViewUtill::broadcast_shape(u.shape(), v.shape());
-            Tensor w(shape);
-            for (int i = 0; i < w.size(); i++) {
-                Indices indices = ViewUtill::unravel(i, w.shape(), w.strides());
-                float u_value = u.value(ViewUtill::reshape_indices(indices, u.shape()));
-                float v_value = v.value(ViewUtill::reshape_indices(indices, v.shape()));
-                w.values()[i] = u_value / v_value;
-            }
-            w.add_edge(u), w.add_edge(v);
-            return w;
+            return elementwise(u, v, [] (float a, float b) { return a / b; });
         }
 
         void division_backward_fn(const Tensor& w) {
-            assert((int)w.edges().size() == 2);
-            Tensor u = w.edges()[0];
-            Tensor v = w.edges()[1];
-            for (int i = 0; i < w.size(); i++) {
-                Indices indices = ViewUtill::unravel(i, w.shape(), w.strides());
-                Indices u_indices = ViewUtill::reshape_indices(indices, u.shape());
-                Indices v_indices = ViewUtill::reshape_indices(indices, v.shape());
-                float u_value = u.value(u_indices);
-                float v_value = v.value(v_indices);
-                u.grad(u_indices) += w.grads()[i] * (1.0f / v_value);
-                v.grad(v_indices) += w.grads()[i] * (-u_value / (v_value * v_value));
-            }
+            elementwise_backward(
+                w,
+                [] (float g, float a, float b) { return g * (1.0f / b); },
+                [] (float g, float a, float b) { return g * (-a / (b * b)); }
+            );
         }
 
         Tensor sum(const Tensor& u, int axis) {
@@ -209,7 +325,7 @@ namespace RevGrad {
                     sum += u.values()[i];
                 }
                 Tensor w(sum);
-                w.meta_data()["axis"] = axis;
+                w.axis() = axis;
                 w.add_edge(u);
                 return w;
             }
@@ -233,7 +349,7 @@ namespace RevGrad {
                 w.shape() = Shape({1});
                 w.strides() = ViewUtill::strides_from_shape(w.shape());
             }
-            w.meta_data()["axis"] = axis;
+            w.axis() = axis;
             w.add_edge(u);
             return w;
         }
@@ -241,8 +357,10 @@ namespace RevGrad {
         void sum_backward_fn(const Tensor& w) {
             assert((int)w.edges().size() == 1);
             Tensor u = w.edges()[0];
-            assert(w.meta_data().count("axis"));
-            int axis = w.meta_data().at("axis");
+            if (u.grads().empty()) {
+                return; // made under NoGrad
+            }
+            int axis = w.axis();
             if (axis == -1) {
                 assert(w.size() == 1);
                 for (int i = 0; i < u.size(); i++) {
@@ -283,16 +401,18 @@ namespace RevGrad {
                 w.shape() = Shape({1});
                 w.strides() = ViewUtill::strides_from_shape(w.shape());
             }
-            w.meta_data()["axis"] = axis;
+            w.axis() = axis;
             w.add_edge(u);
             return w;
         }
 
         void max_backward_fn(const Tensor& w) {
             assert((int)w.edges().size() == 1);
-            assert(w.meta_data().count("axis"));
-            int axis = w.meta_data().at("axis");
+            int axis = w.axis();
             Tensor u = w.edges()[0];
+            if (u.grads().empty()) {
+                return; // made under NoGrad
+            }
             for (int i = 0; i < w.size(); i++) {
                 Indices indices = ViewUtill::unravel(i, w.shape(), w.strides());
                 indices.insert(indices.begin() + axis, 0);
@@ -315,9 +435,7 @@ namespace RevGrad {
 
         Tensor exp(const Tensor& u) {
             Tensor w(u.shape());
-            for (int i = 0; i < u.size(); i++) {
-                w.values()[i] = std::exp(u.values()[i]);
-            }
+            Kernel::exp(u.values().data(), w.values().data(), u.size());
             w.add_edge(u);
             return w;
         }
@@ -325,8 +443,11 @@ namespace RevGrad {
         void exp_backward_fn(const Tensor& w) {
             assert((int)w.edges().size() == 1);
             Tensor u = w.edges()[0];
+            if (u.grads().empty()) {
+                return; // made under NoGrad
+            }
             for (int i = 0; i < u.size(); i++) {
-                u.grads()[i] += w.grads()[i] * std::exp(u.values()[i]);
+                u.grads()[i] += w.grads()[i] * w.values()[i];
             }
         }
 
@@ -337,8 +458,8 @@ namespace RevGrad {
                 assert(!(value != value)); // nan
                 assert(value != 0.0f);
                 assert(value > 0.0f);
-                w.values()[i] = std::log(value);
             }
+            Kernel::log(u.values().data(), w.values().data(), u.size());
             w.add_edge(u);
             return w;
         }
@@ -346,6 +467,9 @@ namespace RevGrad {
         void log_backward_fn(const Tensor& w) {
             assert((int)w.edges().size() == 1);
             Tensor u = w.edges()[0];
+            if (u.grads().empty()) {
+                return; // made under NoGrad
+            }
             for (int i = 0; i < u.size(); i++) {
                 u.grads()[i] += w.grads()[i] * (1 / u.values()[i]);
             }
@@ -363,6 +487,9 @@ namespace RevGrad {
         void relu_backward_fn(const Tensor& w) {
             assert((int)w.edges().size() == 1);
             Tensor u = w.edges()[0];
+            if (u.grads().empty()) {
+                return; // made under NoGrad
+            }
             for (int i = 0; i < u.size(); i++) {
                 u.grads()[i] += w.grads()[i] * (u.values()[i] > 0.0f ? 1.0f : 0.0f);
             }
@@ -370,15 +497,7 @@ namespace RevGrad {
 
         Tensor sigmoid(const Tensor& u) {
             Tensor w(u.shape());
-            for (int i = 0; i < u.size(); i++) {
-                float value = u.values()[i];
-                if (0 < value) {
-                    w.values()[i] = 1.0f / (1.0f + std::exp(-value));
-                } else {
-                    float exp_value = std::exp(value);
-                    w.values()[i] = exp_value / (1.0f + exp_value);
-                }
-            }
+            Kernel::sigmoid(u.values().data(), w.values().data(), u.size());
             w.add_edge(u);
             return w;
         }
@@ -386,85 +505,152 @@ namespace RevGrad {
         void sigmoid_backward_fn(const Tensor& w) {
             assert((int)w.edges().size() == 1);
             Tensor u = w.edges()[0];
+            if (u.grads().empty()) {
+                return; // made under NoGrad
+            }
             for (int i = 0; i < u.size(); i++) {
                 float value = w.values()[i];
                 u.grads()[i] += w.grads()[i] * (value * (1 - value));
             }
         }
 
+        /*
+            Writes the max of every column of u to mx, u is {features, batch_size}
+        */
+        static void column_max(const Tensor& u, std::vector<float>& mx) {
+            int features = u.shape()[0], batch_size = u.shape()[1];
+            const float* x = u.values().data();
+            mx.assign(x, x + batch_size);
+            for (int i = 1; i < features; i++) {
+                for (int k = 0; k < batch_size; k++) {
+                    mx[k] = std::max(mx[k], x[i * batch_size + k]);
+                }
+            }
+        }
+
         Tensor softmax(const Tensor& u) {
-            Tensor mx = Tensor::max(u);
-            Tensor exp = Tensor::exp(u - mx);
-            Tensor s = exp / Tensor::sum(exp, 0);
+            assert((int)u.shape().size() == 2);
             Tensor w(u.shape());
-            w.values() = s.values();
+            int features = u.shape()[0], batch_size = u.shape()[1];
+            const float* x = u.values().data();
+            float* y = w.values().data();
+            std::vector<float> mx, sum(batch_size, 0.0f);
+            column_max(u, mx);
+            for (int i = 0; i < features; i++) {
+                for (int k = 0; k < batch_size; k++) {
+                    y[i * batch_size + k] = x[i * batch_size + k] - mx[k];
+                }
+                Kernel::exp(y + i * batch_size, y + i * batch_size, batch_size);
+                for (int k = 0; k < batch_size; k++) {
+                    sum[k] += y[i * batch_size + k];
+                }
+            }
+            for (int k = 0; k < batch_size; k++) {
+                sum[k] = 1.0f / sum[k];
+            }
+            for (int i = 0; i < features; i++) {
+                for (int k = 0; k < batch_size; k++) {
+                    y[i * batch_size + k] *= sum[k];
+                }
+            }
             w.add_edge(u);
             return w;
         }
 
+        /*
+            du_i = s_i * (dw_i - sum_j dw_j * s_j), with s the output
+        */
         void softmax_backward_fn(const Tensor& w) {
             assert((int)w.edges().size() == 1);
             Tensor u = w.edges()[0];
-            Shape shape = u.shape();
-            assert((int)shape.size() == 2); // {features, batch_size}
-            for (int k = 0; k < shape[1]; k++) { // batch_size
-                for (int i = 0; i < shape[0]; i++) { // features
-                    float value_i = w.values()[i * shape[1] + k];
-                    for (int j = 0; j < shape[0]; j++) { // features
-                        float value_j = w.values()[j * shape[1] + k];
-                        u.grads()[i * shape[1] + k] += w.grads()[j * shape[1] + k] * (value_i * ((i == j) - value_j));
-                    }
+            if (u.grads().empty()) {
+                return; // made under NoGrad
+            }
+            assert((int)u.shape().size() == 2);
+            int features = u.shape()[0], batch_size = u.shape()[1];
+            const float* s = w.values().data();
+            const float* dw = w.grads().data();
+            float* du = u.grads().data();
+            std::vector<float> dot(batch_size, 0.0f);
+            for (int i = 0; i < features; i++) {
+                for (int k = 0; k < batch_size; k++) {
+                    dot[k] += dw[i * batch_size + k] * s[i * batch_size + k];
+                }
+            }
+            for (int i = 0; i < features; i++) {
+                for (int k = 0; k < batch_size; k++) {
+                    int index = i * batch_size + k;
+                    du[index] += s[index] * (dw[index] - dot[k]);
                 }
             }
         }
 
         Tensor log_softmax(const Tensor& u) {
-            Tensor mx = Tensor::max(u);
-            Tensor s = u - mx - Tensor::log(Tensor::sum(Tensor::exp(u - mx), 0));
+            assert((int)u.shape().size() == 2);
             Tensor w(u.shape());
-            assert(s.shape() == w.shape());
-            w.values() = s.values();
+            int features = u.shape()[0], batch_size = u.shape()[1];
+            const float* x = u.values().data();
+            float* y = w.values().data();
+            std::vector<float> mx, sum(batch_size, 0.0f), exp(batch_size);
+            column_max(u, mx);
+            for (int i = 0; i < features; i++) {
+                for (int k = 0; k < batch_size; k++) {
+                    y[i * batch_size + k] = x[i * batch_size + k] - mx[k];
+                }
+                Kernel::exp(y + i * batch_size, exp.data(), batch_size);
+                for (int k = 0; k < batch_size; k++) {
+                    sum[k] += exp[k];
+                }
+            }
+            Kernel::log(sum.data(), sum.data(), batch_size);
+            for (int i = 0; i < features; i++) {
+                for (int k = 0; k < batch_size; k++) {
+                    y[i * batch_size + k] -= sum[k];
+                }
+            }
             w.add_edge(u);
             return w;
         }
 
+        /*
+            du_i = dw_i - exp(w_i) * sum_j dw_j, the softmax comes back from the output
+        */
         void log_softmax_backward_fn(const Tensor& w) {
             assert((int)w.edges().size() == 1);
             Tensor u = w.edges()[0];
-            Tensor mx = Tensor::max(u);
-            Tensor exp = Tensor::exp(u - mx);
-            Tensor s = exp / Tensor::sum(exp, 0);
-            Shape shape = u.shape();
-            assert((int)shape.size() == 2);
-            for (int k = 0; k < shape[1]; k++) { // batch_size
-                for (int i = 0; i < shape[0]; i++) { // features
-                    float value_i = s.values()[i * shape[1] + k];
-                    for (int j = 0; j < shape[0]; j++) { // features
-                        u.grads()[i * shape[1] + k] += w.grads()[j * shape[1] + k] * ((i == j) - value_i);
-                    }
+            if (u.grads().empty()) {
+                return; // made under NoGrad
+            }
+            assert((int)u.shape().size() == 2);
+            int features = u.shape()[0], batch_size = u.shape()[1];
+            const float* dw = w.grads().data();
+            float* du = u.grads().data();
+            std::vector<float> sum(batch_size, 0.0f), s(batch_size);
+            for (int i = 0; i < features; i++) {
+                for (int k = 0; k < batch_size; k++) {
+                    sum[k] += dw[i * batch_size + k];
+                }
+            }
+            for (int i = 0; i < features; i++) {
+                Kernel::exp(w.values().data() + i * batch_size, s.data(), batch_size);
+                for (int k = 0; k < batch_size; k++) {
+                    int index = i * batch_size + k;
+                    du[index] += dw[index] - s[k] * sum[k];
                 }
             }
         }
 
         Tensor matmul(const Tensor& u, const Tensor& v) {
-            Shape w_shape = Shape({u.shape()[0], v.shape()[1]});
-            Tensor w(w_shape);
-            std::vector<float> w_values = w.values();
-            std::vector<float> u_values = u.values();
-            std::vector<float> v_values = v.values();
-            Shape u_shape = u.shape();
-            Shape v_shape = v.shape();
-            //#pragma omp parallel for
-            for (int i = 0; i < w_shape[0]; i++) {
-                for (int j = 0; j < w_shape[1]; j++) {
-                    float sum = 0.0f;
-                    for (int k = 0; k < u_shape[1]; k++) {
-                        sum += u_values[i * u_shape[1] + k] * v_values[k * v_shape[1] + j];
-                    }
-                    w_values[i * w_shape[1] + j] = sum;
-                }
-            }
-            w.values() = w_values;
+            int m = u.shape()[0];
+            int k = u.shape()[1];
+            int n = v.shape()[1];
+            Tensor w(Shape({m, n}));
+            Kernel::gemm(
+                false, false, m, n, k,
+                1.0f, u.values().data(), k,
+                v.values().data(), n,
+                0.0f, w.values().data(), n
+            );
             w.add_edge(u), w.add_edge(v);
             return w;
         }
@@ -473,38 +659,129 @@ namespace RevGrad {
             assert((int)w.edges().size() == 2);
             Tensor u = w.edges()[0];
             Tensor v = w.edges()[1];
-            std::vector<float> u_values = u.values();
-            std::vector<float> v_values = v.values();
-            std::vector<float> w_grads = w.grads();
-            std::vector<float> u_grads = u.grads();
-            std::vector<float> v_grads = v.grads();
-            Shape w_shape = w.shape();
-            Shape u_shape = u.shape();
-            Shape v_shape = v.shape();
-            //#pragma omp parallel for
-            for (int i = 0; i < w_shape[0]; i++) {
-                for (int k = 0; k < u_shape[1]; k++) {
-                    for (int j = 0; j < w_shape[1]; j++) {
-                        u_grads[i * u_shape[1] + k] += (
-                            w_grads[i * w_shape[1] + j] * 
-                            v_values[k * v_shape[1] + j]
-                        );
-                        v_grads[k * v_shape[1] + j] += (
-                            w_grads[i * w_shape[1] + j] * 
-                            u_values[i * u_shape[1] + k]
-                        );
+            int m = u.shape()[0];
+            int k = u.shape()[1];
+            int n = v.shape()[1];
+            // du += dw * v^T
+            if (!u.grads().empty()) {
+                Kernel::gemm(
+                    false, true, m, k, n,
+                    1.0f, w.grads().data(), n,
+                    v.values().data(), n,
+                    1.0f, u.grads().data(), k
+                );
+            }
+            // dv += u^T * dw
+            if (!v.grads().empty()) {
+                Kernel::gemm(
+                    true, false, k, n, m,
+                    1.0f, u.values().data(), k,
+                    w.grads().data(), n,
+                    1.0f, v.grads().data(), n
+                );
+            }
+        }
+
+        /*
+            w = activation(weights * x + bias) in one op: the bias is written into w
+            and the product accumulated onto it, then the activation is applied in place
+        */
+        Tensor linear(const Tensor& weights, const Tensor& x, const Tensor& bias, Activation activation) {
+            int m = weights.shape()[0];
+            int k = weights.shape()[1];
+            int n = x.shape()[1];
+            Tensor w(Shape({m, n}));
+            float* c = w.values().data();
+            for (int i = 0; i < m; i++) {
+                std::fill(c + i * n, c + (i + 1) * n, bias.values()[i]);
+            }
+            Kernel::gemm(
+                false, false, m, n, k,
+                1.0f, weights.values().data(), k,
+                x.values().data(), n,
+                1.0f, c, n
+            );
+            int size = m * n;
+            if (activation == Activation::RELU) {
+                #pragma omp simd
+                for (int i = 0; i < size; i++) {
+                    c[i] = std::max(0.0f, c[i]);
+                }
+            } else if (activation == Activation::SIGMOID) {
+                Kernel::sigmoid(c, c, size);
+            }
+            w.add_edge(weights), w.add_edge(x), w.add_edge(bias);
+            return w;
+        }
+
+        /*
+            The gradient at the pre-activation is found from the output alone,
+            then flows to the weights, the input and the bias
+        */
+        template <Activation activation>
+        void linear_backward(const Tensor& w) {
+            assert((int)w.edges().size() == 3);
+            Tensor weights = w.edges()[0];
+            Tensor x = w.edges()[1];
+            Tensor bias = w.edges()[2];
+            int m = weights.shape()[0];
+            int k = weights.shape()[1];
+            int n = x.shape()[1];
+            int size = m * n;
+            const float* y = w.values().data();
+            const float* dy = w.grads().data();
+            Gradients dz(size);
+            if (activation == Activation::RELU) {
+                #pragma omp simd
+                for (int i = 0; i < size; i++) {
+                    dz[i] = y[i] > 0.0f ? dy[i] : 0.0f;
+                }
+            } else if (activation == Activation::SIGMOID) {
+                #pragma omp simd
+                for (int i = 0; i < size; i++) {
+                    dz[i] = dy[i] * (y[i] * (1 - y[i]));
+                }
+            } else {
+                std::copy(dy, dy + size, dz.begin());
+            }
+            // dweights += dz * x^T
+            if (!weights.grads().empty()) {
+                Kernel::gemm(
+                    false, true, m, k, n,
+                    1.0f, dz.data(), n,
+                    x.values().data(), n,
+                    1.0f, weights.grads().data(), k
+                );
+            }
+            // dx += weights^T * dz
+            if (!x.grads().empty()) {
+                Kernel::gemm(
+                    true, false, k, n, m,
+                    1.0f, weights.values().data(), k,
+                    dz.data(), n,
+                    1.0f, x.grads().data(), n
+                );
+            }
+            // dbias += dz summed over the batch
+            if (!bias.grads().empty()) {
+                for (int i = 0; i < m; i++) {
+                    float sum = 0.0f;
+                    #pragma omp simd reduction(+:sum)
+                    for (int j = 0; j < n; j++) {
+                        sum += dz[i * n + j];
                     }
+                    bias.grads()[i] += sum;
                 }
             }
-            u.grads() = u_grads;
-            v.grads() = v_grads;
         }
+
+        void linear_backward_fn(const Tensor& w) { linear_backward<Activation::NONE>(w); }
+        void linear_relu_backward_fn(const Tensor& w) { linear_backward<Activation::RELU>(w); }
+        void linear_sigmoid_backward_fn(const Tensor& w) { linear_backward<Activation::SIGMOID>(w); }
     }
 
-    std::random_device Tensor::rd = std::random_device();
-    std::mt19937 Tensor::rng = std::mt19937(rd());
-    std::vector<float> Tensor::random_vector(int n, int in_degree) {
-        std::vector<float> r(n);
+    Values Tensor::random_vector(int n, int in_degree, Random& rng) {
+        Values r(n);
         std::normal_distribution<float> he_dist(0.0f, std::sqrt(2.0f / in_degree));
         for (int i = 0; i < n; i++) {
             r[i] = he_dist(rng);
@@ -512,9 +789,12 @@ namespace RevGrad {
         return r;
     }
 
-    Tensor::Tensor(float value) : _data(std::make_shared<Node>(value)) {}
-    Tensor::Tensor(Shape shape, float value) : _data(std::make_shared<Node>(shape, value)) {}
-    Tensor::Tensor(Shape shape, Values values) : _data(std::make_shared<Node>(shape, values)) {}
+    Tensor::Tensor(float value) 
+        : _data(std::allocate_shared<Node>(ArenaAllocator<Node>(), value)) {}
+    Tensor::Tensor(Shape shape, float value) 
+        : _data(std::allocate_shared<Node>(ArenaAllocator<Node>(), shape, value)) {}
+    Tensor::Tensor(Shape shape, Values values) 
+        : _data(std::allocate_shared<Node>(ArenaAllocator<Node>(), shape, values)) {}
 
     Tensor Tensor::from_csv(const std::string& filename) {
         std::ifstream file(filename);
@@ -534,7 +814,7 @@ namespace RevGrad {
         for (int i = 1; i < (int)rows.size(); i++) {
             assert(rows[i].size() == rows[0].size());
         }
-        std::vector<float> values;
+        Values values;
         for (int i = 0; i < (int)rows.size(); i++) {
             for (auto value : rows[i]) {
                 values.push_back(value);
@@ -543,8 +823,8 @@ namespace RevGrad {
         return Tensor(Shape({(int)rows.size(), (int)rows[0].size()}), values);
     }
 
-    Tensor Tensor::random(Shape shape, int in_degree) {
-        return Tensor(shape, random_vector(ViewUtill::shape_size(shape), in_degree));
+    Tensor Tensor::random(Shape shape, int in_degree, Random& rng) {
+        return Tensor(shape, random_vector(ViewUtill::shape_size(shape), in_degree, rng));
     }
 
     const Data& Tensor::data() const { return _data; }
@@ -556,7 +836,10 @@ namespace RevGrad {
         tensor.strides() = strides();
         tensor.grads() = grads();
         tensor.edges() = edges();
-        tensor.backward_fn() = backward_fn();
+        tensor.axis() = axis();
+        if (!edges().empty()) {
+            tensor.record(backward_fn());
+        }
         return tensor;
     }
 
@@ -572,47 +855,60 @@ namespace RevGrad {
     const Edges& Tensor::edges() const { return _data->edges; }
     BackwardFn& Tensor::backward_fn() { return _data->backward_fn; }
     const BackwardFn& Tensor::backward_fn() const { return _data->backward_fn; }
-    MetaData& Tensor::meta_data() { return _data->meta_data; }
-    const MetaData& Tensor::meta_data() const { return _data->meta_data; }
+    int& Tensor::axis() { return _data->axis; }
+    int Tensor::axis() const { return _data->axis; }
 
     float& Tensor::value(const Indices& indices) {
         return values()[ViewUtill::ravel(indices, strides())];
     }
-    const float& Tensor::value(const std::vector<int>& indices) const {
+    const float& Tensor::value(const Indices& indices) const {
         return values()[ViewUtill::ravel(indices, strides())];
     }
     float& Tensor::grad(const Indices& indices) {
         return grads()[ViewUtill::ravel(indices, strides())];
     }
-    const float& Tensor::grad(const std::vector<int>& indices) const {
+    const float& Tensor::grad(const Indices& indices) const {
         return grads()[ViewUtill::ravel(indices, strides())];
     }
 
-    void Tensor::add_edge(const Tensor& tensor) { _data->edges.push_back(tensor); }
+    void Tensor::add_edge(const Tensor& tensor) {
+        if (NoGrad::enabled) {
+            return;
+        }
+        _data->edges.push_back(tensor);
+    }
+
+    void Tensor::record(const BackwardFn& backward_fn) {
+        this->backward_fn() = backward_fn;
+        if (NoGrad::enabled) {
+            return;
+        }
+        Tape::record(*this);
+    }
 
     bool Tensor::operator<(const Tensor& other) const { return _data < other._data; }
     
     Tensor operator+(const Tensor& u, const Tensor& v) {
         Tensor w = TensorUtill::addition(u, v);
-        w.backward_fn() = TensorUtill::addition_backward_fn;
+        w.record(TensorUtill::addition_backward_fn);
         return w;
     }
 
     Tensor operator-(const Tensor& u, const Tensor& v) {
         Tensor w = TensorUtill::subtraction(u, v);
-        w.backward_fn() = TensorUtill::subtraction_backward_fn;
+        w.record(TensorUtill::subtraction_backward_fn);
         return w;
     }
 
     Tensor operator*(const Tensor& u, const Tensor& v) {
         Tensor w = TensorUtill::multiplication(u, v);
-        w.backward_fn() = TensorUtill::multiplication_backward_fn;
+        w.record(TensorUtill::multiplication_backward_fn);
         return w;
     }
 
     Tensor operator/(const Tensor& u, const Tensor& v) {
         Tensor w = TensorUtill::division(u, v);
-        w.backward_fn() = TensorUtill::division_backward_fn;
+        w.record(TensorUtill::division_backward_fn);
         return w;
     }
 
@@ -624,7 +920,7 @@ namespace RevGrad {
 
     Tensor Tensor::sum(const Tensor& u, int axis) {
         Tensor w = TensorUtill::sum(u, axis);
-        w.backward_fn() = TensorUtill::sum_backward_fn;
+        w.record(TensorUtill::sum_backward_fn);
         return w;
     }
 
@@ -635,45 +931,45 @@ namespace RevGrad {
     Tensor Tensor::max(const Tensor& u, int axis) {
         assert(axis >= 0 && axis < (int)u.shape().size());
         Tensor w = TensorUtill::max(u, axis);
-        w.backward_fn() = TensorUtill::max_backward_fn;
+        w.record(TensorUtill::max_backward_fn);
         return w;
     }
 
     Tensor Tensor::exp(const Tensor& u) {
         Tensor w = TensorUtill::exp(u);
-        w.backward_fn() = TensorUtill::exp_backward_fn;
+        w.record(TensorUtill::exp_backward_fn);
         return w;
     }
 
     Tensor Tensor::log(const Tensor& u) {
         Tensor w = TensorUtill::log(u);
-        w.backward_fn() = TensorUtill::log_backward_fn;
+        w.record(TensorUtill::log_backward_fn);
         return w;
     }
 
     Tensor Tensor::relu(const Tensor& u) {
         Tensor w = TensorUtill::relu(u);
-        w.backward_fn() = TensorUtill::relu_backward_fn;
+        w.record(TensorUtill::relu_backward_fn);
         return w;
     }
     
     Tensor Tensor::sigmoid(const Tensor& u) {
         Tensor w = TensorUtill::sigmoid(u);
-        w.backward_fn() = TensorUtill::sigmoid_backward_fn;
+        w.record(TensorUtill::sigmoid_backward_fn);
         return w;
     }
 
     Tensor Tensor::softmax(const Tensor& u) {
         assert((int)u.shape().size() == 2); // {features, batch_size}
         Tensor w = TensorUtill::softmax(u);
-        w.backward_fn() = TensorUtill::softmax_backward_fn;
+        w.record(TensorUtill::softmax_backward_fn);
         return w;
     }
 
     Tensor Tensor::log_softmax(const Tensor& u) {
         assert((int)u.shape().size() == 2); // {features, batch_size}
         Tensor w = TensorUtill::log_softmax(u);
-        w.backward_fn() = TensorUtill::log_softmax_backward_fn;
+        w.record(TensorUtill::log_softmax_backward_fn);
         return w;
     }
 
@@ -681,10 +977,33 @@ namespace RevGrad {
         assert((int)u.shape().size() == 2 && (int)v.shape().size() == 2);
         assert(u.shape()[1] == v.shape()[0]);
         Tensor w = TensorUtill::matmul(u, v);
-        w.backward_fn() = TensorUtill::matmul_backward_fn;
+        w.record(TensorUtill::matmul_backward_fn);
+        return w;
+    }
+
+    Tensor Tensor::linear(const Tensor& weights, const Tensor& x, const Tensor& bias, Activation activation) {
+        assert((int)weights.shape().size() == 2 && (int)x.shape().size() == 2);
+        assert(weights.shape()[1] == x.shape()[0]);
+        assert(bias.size() == weights.shape()[0]);
+        Tensor w = TensorUtill::linear(weights, x, bias, activation);
+        if (activation == Activation::RELU) {
+            w.record(TensorUtill::linear_relu_backward_fn);
+        } else if (activation == Activation::SIGMOID) {
+            w.record(TensorUtill::linear_sigmoid_backward_fn);
+        } else {
+            w.record(TensorUtill::linear_backward_fn);
+        }
         return w;
     }
 
+    Tensor Tensor::linear_relu(const Tensor& weights, const Tensor& x, const Tensor& bias) {
+        return linear(weights, x, bias, Activation::RELU);
+    }
+
+    Tensor Tensor::linear_sigmoid(const Tensor& weights, const Tensor& x, const Tensor& bias) {
+        return linear(weights, x, bias, Activation::SIGMOID);
+    }
+
     int Tensor::size() const {
         return ViewUtill::shape_size(shape());
     }
@@ -705,14 +1024,16 @@ namespace RevGrad {
         Shape shape = {this->shape()[1], this->shape()[0]};
         int n = size();
         Values values(n);
-        Gradients grads(n);
+        Gradients grads(this->grads().empty() ? 0 : n);
         Strides strides = ViewUtill::strides_from_shape(shape);
         for (int i = 0; i < this->shape()[0]; i++) {
             for (int j = 0; j < this->shape()[1]; j++) {
                 float value =this->values()[i * this->strides()[0] + j * this->strides()[1]];
-                float grad =this->grads()[i * this->strides()[0] + j * this->strides()[1]];
                 values[j * strides[0] + i * strides[1]] = value;
-                grads[j * strides[0] + i * strides[1]] = grad;
+                if (!grads.empty()) {
+                    float grad =this->grads()[i * this->strides()[0] + j * this->strides()[1]];
+                    grads[j * strides[0] + i * strides[1]] = grad;
+                }
             }
         }
         this->shape() = shape;
@@ -743,42 +1064,40 @@ namespace RevGrad {
         return tensor;
     }
 
-    void Tensor::backward() {
-        grads() = std::vector<float>(grads().size(), 1.0f);
-        std::map<Tensor, std::vector<Tensor>> adj;
-        std::queue<Tensor> Q;
-        Q.push(*this);
-        std::set<Tensor> S;
-        while (!Q.empty()) {
-            Tensor u = Q.front();
-            Q.pop();
-            if (S.count(u)) {
-                continue;
-            }
-            S.insert(u);
-            for (Tensor v : u.edges()) {
-                adj[u].push_back(v);
-                Q.push(v);
-            }
+    /*
+        Runs the backward functions of everything w depends on, 
+        the gradient of w is already in place
+    */
+    static void backpropagate(const Tensor& w) {
+        int index = w.data()->tape_index;
+        if (index == -1) {
+            assert(w.edges().empty()); // otherwise the tape was cleared under it
+            return;
         }
-        S.clear();
-        std::vector<Tensor> order;
-        std::function<void(Tensor)> topsort;
-        topsort = [&topsort, &adj, &S, &order] (Tensor u) -> void {
-            S.insert(u);
-            for (auto v : adj[u]) {
-                if (!S.count(v)) {
-                    topsort(v);
-                }
+        assert(index < (int)Tape::tensors.size() && Tape::tensors[index].data() == w.data());
+        // a tensor is reached when its mark is the epoch of this pass
+        uint64_t epoch = ++Tape::epoch;
+        w.data()->mark = epoch;
+        for (int i = index; i >= 0; i--) {
+            const Tensor& u = Tape::tensors[i];
+            if (u.data()->mark != epoch) {
+                continue;
             }
-            order.push_back(u);
-        };
-        topsort(*this);
-        std::reverse(order.begin(), order.end());
-        for (Tensor u : order) {
-            if (u.backward_fn()) {
-                u.backward_fn()(u);
+            u.backward_fn()(u);
+            for (const Tensor& v : u.edges()) {
+                v.data()->mark = epoch;
             }
         }
     }
+
+    void Tensor::backward() {
+        std::fill(grads().begin(), grads().end(), 1.0f);
+        backpropagate(*this);
+    }
+
+    void Tensor::backward(const std::vector<float>& prior) {
+        assert((int)prior.size() == size());
+        std::copy(prior.begin(), prior.end(), grads().begin());
+        backpropagate(*this);
+    }
 }
@@ -17,23 +17,33 @@
 #include <map>
 #include <omp.h>
 
+#include "../utill/Random.h"
+#include "../utill/Arena.h"
+#include "../utill/Dims.h"
+
 namespace RevGrad {
     class Node;
+    class Tape;
     class TensorData;
     class Tensor;
 
-    typedef std::vector<float> Values;
-    typedef std::vector<float> Gradients;
-    typedef std::vector<int> Shape;
-    typedef std::vector<int> Strides;
-    typedef std::vector<int> Indices;
+    typedef std::vector<float, ArenaAllocator<float>> Values;
+    typedef std::vector<float, ArenaAllocator<float>> Gradients;
+    typedef Dims Shape;
+    typedef Dims Strides;
+    typedef Dims Indices;
     typedef std::shared_ptr<Node> Data;
-    typedef std::vector<Tensor> Edges;
-    typedef std::function<void(const Tensor&)> BackwardFn;
-    typedef std::map<std::string, int> MetaData;
+    typedef std::vector<Tensor, ArenaAllocator<Tensor>> Edges;
+    typedef void (*BackwardFn)(const Tensor&);
+
+    enum class Activation { 
+        NONE, 
+        RELU, 
+        SIGMOID 
+    };
 
     namespace ViewUtill {
-        int shape_size(Shape shape);
+        int shape_size(const Shape& shape);
         Strides strides_from_shape(Shape shape);
         Shape broadcast_shape(const Shape& a, const Shape& b);
         Indices unravel(int index, const Shape& shape, const Strides& strides);
@@ -41,6 +51,21 @@ namespace RevGrad {
         Indices reshape_indices(const Indices& indices, const Shape& shape);
     }
 
+    /*
+        While a NoGrad guard is alive, tensors made on its thread get no gradient buffer
+        and ops record no edges. Such a tensor can still be the input of an op made outside
+        the guard, backward then passes no gradient to it, like a constant
+    */
+    class NoGrad {
+        bool previous;
+    public:
+        static thread_local bool enabled;
+        NoGrad();
+        ~NoGrad();
+        NoGrad(const NoGrad&) = delete;
+        NoGrad& operator=(const NoGrad&) = delete;
+    };
+
     class Node {
         public:
         Values values;
@@ -48,13 +73,29 @@ namespace RevGrad {
         Strides strides;
         Gradients grads;
         Edges edges;
-        BackwardFn backward_fn;
-        MetaData meta_data;
+        BackwardFn backward_fn = nullptr;
+        int axis = 0; // of sum and max
+        int tape_index = -1;
+        uint64_t mark = 0;
         Node(float value = 0.0f);
         Node(Shape shape, float value = 0.0f);
         Node(Shape shape, Values values);
     };
 
+    /*
+        The tensors made by ops on this thread, in the order they were made (a Wengert list).
+        An op always comes after its inputs, so backward is a reverse walk of the tape.
+        The tape keeps its tensors alive until it is cleared
+    */
+    class Tape {
+    public:
+        static thread_local std::vector<Tensor> tensors;
+        static thread_local uint64_t epoch;
+        static void record(const Tensor& tensor);
+        static void rewind(int size);
+        static void clear();
+    };
+
     namespace TensorUtill {
         Tensor addition(const Tensor& u, const Tensor& v);
         void addition_backward_fn(const Tensor& w);
@@ -82,19 +123,21 @@ namespace RevGrad {
         void log_softmax_backward_fn(const Tensor& w);
         Tensor matmul(const Tensor& u, const Tensor& v);
         void matmul_backward_fn(const Tensor& w);
+        Tensor linear(const Tensor& weights, const Tensor& x, const Tensor& bias, Activation activation);
+        void linear_backward_fn(const Tensor& w);
+        void linear_relu_backward_fn(const Tensor& w);
+        void linear_sigmoid_backward_fn(const Tensor& w);
     }
 
     class Tensor {
         Data _data;
-        static std::random_device rd;
-        static std::mt19937 rng;
-        static std::vector<float> random_vector(int n, int in_degree);
+        static Values random_vector(int n, int in_degree, Random& rng);
     public:
         Tensor(float value = 0.0f);
         Tensor(Shape shape, float value = 0.0f);
         Tensor(Shape shape, Values values);
         static Tensor from_csv(const std::string& filename);
-        static Tensor random(Shape shape, int in_degree);
+        static Tensor random(Shape shape, int in_degree, Random& rng);
         Tensor clone();
         const Data& data() const;
         Values& values();
@@ -109,13 +152,14 @@ namespace RevGrad {
         const Edges& edges() const;
         BackwardFn& backward_fn();
         const BackwardFn& backward_fn() const;
-        MetaData& meta_data();
-        const MetaData& meta_data() const;
+        int& axis();
+        int axis() const;
         float& value(const Indices& indices);
-        const float& value(const std::vector<int>& indices) const;
+        const float& value(const Indices& indices) const;
         float& grad(const Indices& indices);
-        const float& grad(const std::vector<int>& indices) const;
+        const float& grad(const Indices& indices) const;
         void add_edge(const Tensor& tensor);
+        void record(const BackwardFn& backward_fn);
         bool operator<(const Tensor& other) const;
         friend Tensor operator+(const Tensor& u, const Tensor& v);
         friend Tensor operator-(const Tensor& u, const Tensor& v);
@@ -136,6 +180,18 @@ namespace RevGrad {
         static Tensor softmax(const Tensor& u);
         static Tensor log_softmax(const Tensor& u);
         static Tensor matmul(const Tensor& u, const Tensor& v);
+        /*
+            activation(weights * x + bias) as a single op with a fused backward,
+            x is (features, batch size) and bias is (outputs, 1)
+        */
+        static Tensor linear(
+            const Tensor& weights, 
+            const Tensor& x, 
+            const Tensor& bias, 
+            Activation activation = Activation::NONE
+        );
+        static Tensor linear_relu(const Tensor& weights, const Tensor& x, const Tensor& bias);
+        static Tensor linear_sigmoid(const Tensor& weights, const Tensor& x, const Tensor& bias);
         int size() const;
         void reshape(const Shape& shape);
         void flatten();
@@ -0,0 +1,58 @@
+#include "Arena.h"
+#include "../tensor/Tensor.h"
+
+#include <algorithm>
+
+namespace RevGrad {
+    thread_local Arena* Arena::current = nullptr;
+
+    Arena::Arena(size_t block_size) : block_size(block_size) {}
+
+    Arena::~Arena() {
+        assert(live == 0);
+        for (auto& b : blocks) {
+            ::operator delete(b.data);
+        }
+    }
+
+    void* Arena::allocate(size_t bytes, size_t alignment) {
+        live++;
+        while (block < (int)blocks.size()) {
+            size_t start = (offset + alignment - 1) & ~(alignment - 1);
+            if (start + bytes <= blocks[block].size) {
+                offset = start + bytes;
+                return blocks[block].data + start;
+            }
+            block++, offset = 0;
+        }
+        // blocks are new'ed so they are aligned for any type
+        size_t size = std::max(block_size, bytes);
+        blocks.push_back({static_cast<char*>(::operator new(size)), size});
+        block = blocks.size() - 1;
+        offset = bytes;
+        return blocks[block].data;
+    }
+
+    void Arena::deallocate() {
+        live--;
+    }
+
+    Arena::Scope::Scope(Arena& arena)
+        : arena(arena),
+          previous(Arena::current),
+          block(arena.block),
+          offset(arena.offset),
+          live(arena.live),
+          tape_size(Tape::tensors.size())
+    {
+        Arena::current = &arena;
+    }
+
+    Arena::Scope::~Scope() {
+        Tape::rewind(tape_size);
+        assert(arena.live == live); // a tensor made in the scope outlived it
+        arena.block = block;
+        arena.offset = offset;
+        Arena::current = previous;
+    }
+}
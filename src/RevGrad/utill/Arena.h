@@ -0,0 +1,96 @@
+#ifndef REVGRAD_ARENA_H
+#define REVGRAD_ARENA_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <new>
+
+namespace RevGrad {
+    /*
+        Bump allocator for the short lived nodes and buffers of one step.
+        Memory is handed out from blocks kept across steps and taken back
+        all at once when the Scope that made it ends, freeing is a no-op
+    */
+    class Arena {
+        struct Block {
+            char* data;
+            size_t size;
+        };
+        std::vector<Block> blocks;
+        size_t block_size;
+        int block = 0;
+        size_t offset = 0;
+        int live = 0;
+    public:
+        /*
+            Arena of the innermost Scope on this thread, nullptr outside of any Scope
+        */
+        static thread_local Arena* current;
+        Arena(size_t block_size = 1 << 20);
+        ~Arena();
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+        void* allocate(size_t bytes, size_t alignment);
+        void deallocate();
+
+        /*
+            While alive, tensors made on this thread live in the arena. 
+            On exit the tape is cleared back to where it was and the arena rewinds,
+            so no tensor made inside may outlive the scope
+        */
+        class Scope {
+            Arena& arena;
+            Arena* previous;
+            int block;
+            size_t offset;
+            int live;
+            int tape_size;
+        public:
+            Scope(Arena& arena);
+            ~Scope();
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+        };
+    };
+
+    /*
+        Allocates from the current arena when made inside a Scope and from the heap otherwise.
+        Containers keep the allocator they were made with, 
+        so buffers of parameters made outside a Scope stay on the heap
+    */
+    template <class T>
+    class ArenaAllocator {
+    public:
+        typedef T value_type;
+        typedef std::false_type propagate_on_container_copy_assignment;
+        typedef std::false_type propagate_on_container_move_assignment;
+        typedef std::false_type propagate_on_container_swap;
+        Arena* arena;
+        ArenaAllocator() : arena(Arena::current) {}
+        template <class U>
+        ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+        ArenaAllocator select_on_container_copy_construction() const { return ArenaAllocator(); }
+        T* allocate(size_t n) {
+            if (arena) {
+                return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+            }
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        void deallocate(T* p, size_t n) {
+            if (arena) {
+                arena->deallocate();
+            } else {
+                ::operator delete(p);
+            }
+        }
+    };
+
+    template <class T, class U>
+    bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena == b.arena; }
+    template <class T, class U>
+    bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena != b.arena; }
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef REVGRAD_DIMS_H
+#define REVGRAD_DIMS_H
+
+#include <array>
+#include <cassert>
+#include <initializer_list>
+#include <algorithm>
+
+#define MAX_DIMS 4
+
+namespace RevGrad {
+    /*
+        Up to MAX_DIMS ints stored inline, used for shapes, strides and indices
+        so a tensor needs no heap allocation for them. Has the parts of the
+        std::vector interface the library uses
+    */
+    class Dims {
+        std::array<int, MAX_DIMS> dims{};
+        int count = 0;
+    public:
+        typedef int value_type;
+        typedef int* iterator;
+        typedef const int* const_iterator;
+        Dims() {}
+        explicit Dims(int n, int value = 0) : count(n) {
+            assert(0 <= n && n <= MAX_DIMS);
+            std::fill(begin(), end(), value);
+        }
+        Dims(std::initializer_list<int> list) : count(list.size()) {
+            assert(list.size() <= MAX_DIMS);
+            std::copy(list.begin(), list.end(), begin());
+        }
+        int size() const { return count; }
+        bool empty() const { return count == 0; }
+        int& operator[](int i) { return dims[i]; }
+        const int& operator[](int i) const { return dims[i]; }
+        int& back() { return dims[count - 1]; }
+        const int& back() const { return dims[count - 1]; }
+        iterator begin() { return dims.data(); }
+        iterator end() { return dims.data() + count; }
+        const_iterator begin() const { return dims.data(); }
+        const_iterator end() const { return dims.data() + count; }
+        void push_back(int value) {
+            assert(count < MAX_DIMS);
+            dims[count++] = value;
+        }
+        iterator insert(iterator position, int value) {
+            assert(count < MAX_DIMS);
+            std::copy_backward(position, end(), end() + 1);
+            *position = value;
+            count++;
+            return position;
+        }
+        iterator erase(iterator position) {
+            std::copy(position + 1, end(), position);
+            count--;
+            return position;
+        }
+    };
+
+    inline bool operator==(const Dims& a, const Dims& b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end());
+    }
+
+    inline bool operator!=(const Dims& a, const Dims& b) {
+        return !(a == b);
+    }
+}
+
+#endif
@@ -0,0 +1,55 @@
+#include "Random.h"
+
+namespace RevGrad {
+    static uint64_t splitmix64(uint64_t& x) {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    Random::Random(uint64_t seed, uint64_t stream) {
+        // the stream index is mixed into the seed, so every (seed, stream)
+        // pair starts at an unrelated point of the 2^256 - 1 period
+        uint64_t x = seed;
+        x = splitmix64(x) ^ stream;
+        for (auto& word : state) {
+            word = splitmix64(x);
+        }
+    }
+
+    Random::result_type Random::operator()() {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    int Random::uniform(int n) {
+        // Lemire's multiply and reject, unbiased without a division in the common case
+        uint64_t m = ((*this)() >> 32) * (uint32_t)n;
+        uint32_t low = (uint32_t)m;
+        if (low < (uint32_t)n) {
+            uint32_t threshold = -(uint32_t)n % (uint32_t)n;
+            while (low < threshold) {
+                m = ((*this)() >> 32) * (uint32_t)n;
+                low = (uint32_t)m;
+            }
+        }
+        return (int)(m >> 32);
+    }
+
+    uint64_t Random::entropy() {
+        std::random_device rd;
+        return ((uint64_t)rd() << 32) ^ rd();
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef REVGRAD_RANDOM_H
+#define REVGRAD_RANDOM_H
+
+#include <array>
+#include <cstdint>
+#include <random>
+
+namespace RevGrad {
+    /*
+        xoshiro256** generator, each instance is its own stream so it can be used
+        by one thread without locking. Works with the <random> distributions
+    */
+    class Random {
+        std::array<uint64_t, 4> state;
+    public:
+        typedef uint64_t result_type;
+        /*
+            @param seed master seed
+            @param stream index of the stream, streams of one seed are independent
+        */
+        Random(uint64_t seed = 0, uint64_t stream = 0);
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return UINT64_MAX; }
+        result_type operator()();
+        /*
+            @return uniform integer in [0, n)
+        */
+        int uniform(int n);
+        static uint64_t entropy();
+    };
+}
+
+#endif
@@ -2,6 +2,9 @@
 #include "./player/Player.h"
 #include "./player/Human.h"
 #include "./player/Trainer.h"
+#include "./training/ParallelTrainer.h"
+#include "./training/ActorLearner.h"
+#include "./training/ReplayBuffer.h"
 
 using namespace Backgammon;
 
@@ -24,12 +27,28 @@ int main() {
     int checkpoint = 0;
     int print_frequency = 1'000;
 
+    // Self-play threads, 1 plays the games in order on this thread, so two runs play the same games. 
+    // More threads train one set of weights together in an order that varies between runs, see ParallelTrainer
+    int threads = 1;
+    Sharing sharing = Sharing::HOGWILD;
+    // Or play on threads - 1 actors and learn on one thread, see ActorLearner
+    bool actor_learner = false;
+    // Or, on one thread, learn from mini-batches of the moves in a replay buffer, see ReplayTrainer
+    bool replay = false;
+    int replay_capacity = 50'000;
+
+    // Seeds, game i is played with dice stream i of dice_seed
+    uint64_t weights_seed = 1;
+    uint64_t dice_seed = 2;
+    // WHITE samples the replay buffer with replay_seed, BLACK with replay_seed + 1
+    uint64_t replay_seed = 3;
+
     // Weight filenames
     std::string start_filename = "weights/" + std::to_string(start) + "_games.csv";
     std::string end_filename = "weights/" + std::to_string(end) + "_games.csv";
 
-    // Model
-    std::shared_ptr<Model> model = std::make_shared<Model>(hidden_units);
+    // Model, self-play runs on the hand written backend
+    std::shared_ptr<Model> model = std::make_shared<Model>(hidden_units, weights_seed, Backend::ANALYTIC);
 
     // Load model
     if (start) {
@@ -37,19 +56,55 @@ int main() {
         std::cout << "Loaded weights from file: " << start_filename << std::endl;
     }
 
+    // Play games on several threads, saving between print_frequency blocks
+    if (threads > 1 && !replay) {
+        std::unique_ptr<ParallelTrainer> trainer;
+        std::unique_ptr<ActorLearner> pipeline;
+        if (actor_learner) {
+            pipeline = std::make_unique<ActorLearner>(model, threads - 1, dice_seed);
+        } else {
+            trainer = std::make_unique<ParallelTrainer>(model, threads, dice_seed, sharing);
+        }
+        for (int i = start; i < end; ) {
+            int next = std::min(end, (i / print_frequency + 1) * print_frequency);
+            long long moves = actor_learner ? pipeline->train(i, next) : trainer->train(i, next);
+            std::cout << "Game nr. " << next << std::endl;
+            std::cout << "Avg. nr. of moves made: " << (double)moves / (next - i) << std::endl;
+            i = next;
+
+            while (checkpoint + 1 < (int)checkpoints.size() && checkpoints[checkpoint] < i) {
+                checkpoint++;
+            }
+
+            if (i % checkpoints[checkpoint] == 0) {
+                std::string checkpoint = "weights/" + std::to_string(i) + "_games.csv";
+                model->save(checkpoint);
+                std::cout << "Saved weights in file: " << checkpoint << std::endl;
+            }
+        }
+        model->save(end_filename);
+        std::cout << "Saved weights in file: " << end_filename << std::endl;
+        return 0;
+    }
+
     // Game
-    Game game(
-        std::make_shared<Trainer>("WHITE", model), 
-        std::make_shared<Trainer>("BLACK", model)
-    );
+    std::shared_ptr<Player> white = std::make_shared<Trainer>("WHITE", model);
+    std::shared_ptr<Player> black = std::make_shared<Trainer>("BLACK", model);
+    if (replay) {
+        std::shared_ptr<ReplayBuffer> buffer = std::make_shared<ReplayBuffer>(replay_capacity, model->value_network->inputs);
+        white = std::make_shared<ReplayTrainer>("WHITE", model, buffer, 32, 8, replay_seed);
+        black = std::make_shared<ReplayTrainer>("BLACK", model, buffer, 32, 8, replay_seed + 1);
+    }
+    Game game(white, black, dice_seed);
+    game.games_played = start;
 
     // Play games
     for (int i = start + 1; i <= end; i++) {
         game.play();
         
-        if (i % print_frequency == 0 || (int)game.state.made.size() >= 200) {
+        if (i % print_frequency == 0 || (int)game.history.size() >= 200) {
             std::cout << "Game nr. " << i << std::endl;
-            std::cout << "Nr. of moves made: " << (int)game.state.made.size() << std::endl;
+            std::cout << "Nr. of moves made: " << (int)game.history.size() << std::endl;
         }
 
         while (checkpoint + 1 < (int)checkpoints.size() && checkpoints[checkpoint] < i) {
@@ -5,8 +5,10 @@
 #include <cassert>
 #include <algorithm>
 #include <memory>
+#include <type_traits>
 
 #include "Game.h"
+#include "Observer.h"
 
 namespace Backgammon {
 
@@ -18,7 +20,138 @@ namespace Backgammon {
         return a.from == b.from && a.to == b.to;
     }
 
-    State::State() {
+    void CompactMove::push(int from, int to) {
+        assert(size < MAX_CHECKER_MOVES);
+        checker_moves[size++] = CompactCheckerMove{(int8_t)from, (int8_t)to};
+    }
+
+    void CompactMove::pop() {
+        assert(size > 0);
+        size--;
+    }
+
+    void CompactMove::sort() {
+        // insertion sort, there are at most 4 checker moves
+        for (int i = 1; i < size; i++) {
+            for (int j = i; j > 0 && checker_moves[j] < checker_moves[j - 1]; j--) {
+                std::swap(checker_moves[j], checker_moves[j - 1]);
+            }
+        }
+    }
+
+    Move CompactMove::to_move() const {
+        Move move;
+        for (int i = 0; i < size; i++) {
+            move.push_back(CheckerMove(checker_moves[i].from, checker_moves[i].to));
+        }
+        return move;
+    }
+
+    bool operator<(const CompactCheckerMove& a, const CompactCheckerMove& b) {
+        return a.from == b.from ? a.to < b.to : a.from < b.from;
+    }
+
+    bool operator==(const CompactCheckerMove& a, const CompactCheckerMove& b) {
+        return a.from == b.from && a.to == b.to;
+    }
+
+    bool operator<(const CompactMove& a, const CompactMove& b) {
+        return std::lexicographical_compare(
+            a.checker_moves.begin(), a.checker_moves.begin() + a.size,
+            b.checker_moves.begin(), b.checker_moves.begin() + b.size
+        );
+    }
+
+    bool operator==(const CompactMove& a, const CompactMove& b) {
+        return a.size == b.size && std::equal(
+            a.checker_moves.begin(), a.checker_moves.begin() + a.size,
+            b.checker_moves.begin()
+        );
+    }
+
+    static std::array<std::array<std::array<uint64_t, 16>, 26>, 2> zobrist_table() {
+        // splitmix64 with a fixed seed, so hashes are the same in every run
+        std::array<std::array<std::array<uint64_t, 16>, 26>, 2> table;
+        uint64_t x = 0x9E3779B97F4A7C15ull;
+        for (auto& player : table) {
+            for (auto& point : player) {
+                for (auto& key : point) {
+                    uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+                    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                    key = z ^ (z >> 31);
+                }
+            }
+        }
+        return table;
+    }
+
+    static const std::array<std::array<std::array<uint64_t, 16>, 26>, 2> ZOBRIST = zobrist_table();
+
+    void MoveList::clear() { size = 0; }
+    bool MoveList::empty() const { return size == 0; }
+
+    void MoveList::push(const CompactMove& move) {
+        assert(size < MAX_MOVES);
+        moves[size++] = move;
+    }
+
+    CompactMove& MoveList::operator[](int index) { return moves[index]; }
+    const CompactMove& MoveList::operator[](int index) const { return moves[index]; }
+
+    AfterstateList::AfterstateList() {
+        table.fill(0);
+    }
+
+    void AfterstateList::clear() {
+        // only the used slots are reset, the table is far larger than a typical list
+        for (int i = 0; i < size; i++) {
+            table[slots[i]] = 0;
+        }
+        size = 0;
+    }
+
+    bool AfterstateList::empty() const { return size == 0; }
+
+    bool AfterstateList::insert(const CompactMove& move, uint64_t hash, const Position& position) {
+        // 0 marks an empty slot
+        hash |= 1;
+        int slot = hash & (AFTERSTATE_TABLE_SIZE - 1);
+        while (table[slot]) {
+            if (table[slot] == hash) {
+                return false;
+            }
+            slot = (slot + 1) & (AFTERSTATE_TABLE_SIZE - 1);
+        }
+        assert(size < MAX_AFTERSTATES);
+        table[slot] = hash;
+        slots[size] = slot;
+        afterstates[size] = Afterstate{move, hash, position};
+        afterstates[size].position.turn = !position.turn;
+        size++;
+        return true;
+    }
+
+    int AfterstateList::find(uint64_t hash) const {
+        hash |= 1;
+        for (int i = 0; i < size; i++) {
+            if (afterstates[i].hash == hash) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    Afterstate& AfterstateList::operator[](int index) { return afterstates[index]; }
+    const Afterstate& AfterstateList::operator[](int index) const { return afterstates[index]; }
+
+    static_assert(std::is_trivially_copyable_v<Position> && sizeof(Position) <= 64);
+
+    bool operator==(const Position& a, const Position& b) {
+        return a.turn == b.turn && a.on == b.on;
+    }
+
+    Position::Position() {
         // beginning state
         // turn is not decided yet
         turn = -1;
@@ -32,161 +165,236 @@ namespace Backgammon {
         on[BLACK][16] = 3;
         on[BLACK][18] = 5;
         on[WHITE][23] = 2;
+        refresh();
     }
 
-    int State::compute_pip(int player) const {
-        int pip = 25 * on[player][BAR];
-        for (int point = 0; point < BOARD_SIZE; point++) {
-            pip += on[player][point] * abs(point - (player == WHITE ? -1 : 24));
+    void Position::refresh() {
+        for (int player = 0; player <= 1; player++) {
+            pip[player] = 0;
+            for (int point = 0; point < OUT; point++) {
+                pip[player] += on[player][point] * distance(player, point);
+            }
+            back[player] = furthest(player, 25);
         }
-        return pip;
     }
 
-    bool State::race() const {
-        if (on[WHITE][BAR] || on[BLACK][BAR]) {
-            return false;
+    int Position::distance(int player, int point) {
+        // number of pips from point to bearing off
+        if (point == OUT) {
+            return 0;
         }
-        int sum = on[WHITE][OUT];
-        if (sum == 15) {
-            return true;
+        if (point == BAR) {
+            return 25;
         }
-        for (int point = 0; point < BOARD_SIZE; point++) {
-            if (on[BLACK][point]) {
-                return false;
-            }
-            sum += on[WHITE][point];
-            if (sum == 15) {
-                return true;
+        return player == WHITE ? point + 1 : BOARD_SIZE - point;
+    }
+
+    int Position::furthest(int player, int distance) const {
+        // distance of the furthest back checker at most distance pips away
+        if (distance == 25 && on[player][BAR]) {
+            return 25;
+        }
+        for (int d = std::min(distance, 24); d > 0; d--) {
+            if (on[player][player == WHITE ? d - 1 : BOARD_SIZE - d]) {
+                return d;
             }
         }
-        assert(false);
+        return 0;
+    }
+
+    int Position::compute_pip(int player) const {
+        return pip[player];
+    }
+
+    bool Position::race() const {
+        // no contact left when white's back checker has passed black's back checker
+        return back[WHITE] + back[BLACK] <= BOARD_SIZE;
     }
     
-    void State::make_move(Move move) {
-        Undo undo;
-        for (auto checker_move : move) {
-            auto [from, to] = checker_move;
-            if (to != OUT && on[!turn][to]) {
-                on[!turn][BAR]++;
-                on[!turn][to]--;
-                undo.push_back({!turn, CheckerMove(to, BAR)});
+    bool Position::make_checker_move(int from, int to) {
+        bool hit = to != OUT && on[!turn][to];
+        if (hit) {
+            on[!turn][BAR]++;
+            on[!turn][to]--;
+            pip[!turn] += 25 - distance(!turn, to);
+            back[!turn] = 25;
+        }
+        on[turn][from]--;
+        on[turn][to]++;
+        pip[turn] -= distance(turn, from) - distance(turn, to);
+        if (!on[turn][from] && back[turn] == distance(turn, from)) {
+            back[turn] = furthest(turn, back[turn] - 1);
+        }
+        return hit;
+    }
+
+    void Position::undo_checker_move(int from, int to, bool hit) {
+        on[turn][to]--;
+        on[turn][from]++;
+        pip[turn] += distance(turn, from) - distance(turn, to);
+        back[turn] = std::max<int>(back[turn], distance(turn, from));
+        if (hit) {
+            on[!turn][to]++;
+            on[!turn][BAR]--;
+            pip[!turn] -= 25 - distance(!turn, to);
+            if (!on[!turn][BAR]) {
+                back[!turn] = furthest(!turn, 24);
             }
-            on[turn][from]--;
-            on[turn][to]++;
-            undo.push_back({turn, checker_move});
         }
-        made.push(undo);
     }
 
-    void State::undo_move() {
-        auto undo = made.top();
-        made.pop();
-        for (auto [turn, checker_move] : undo) {
-            auto [from, to] = checker_move;
-            on[turn][to]--;
-            on[turn][from]++;
+    UndoRecord Position::make_move(const CompactMove& move) {
+        UndoRecord undo;
+        undo.move = move;
+        for (int i = 0; i < move.size; i++) {
+            auto [from, to] = move.checker_moves[i];
+            if (make_checker_move(from, to)) {
+                undo.hits |= 1 << i;
+            }
         }
+        return undo;
     }
 
-    Moves State::get_moves(Deltas deltas) {
-        Moves moves;
-        Move move;
-        if (deltas[0] == deltas[1]) {
-            for (int i = 0; i < 4; i++) {
-                move.clear();
-                find_moves(deltas, i, move, moves);
-                if (!moves.empty()) break;
+    void Position::undo_move(const UndoRecord& undo) {
+        for (int i = undo.move.size - 1; i >= 0; i--) {
+            auto [from, to] = undo.move.checker_moves[i];
+            undo_checker_move(from, to, undo.hits >> i & 1);
+        }
+    }
+
+    int Position::move_order(int from) const {
+        // how far the checker on from is from home
+        if (from == BAR) {
+            return BAR;
+        }
+        return turn == WHITE ? from : BOARD_SIZE - 1 - from;
+    }
+
+    void Position::generate_moves(int first, int second, MoveList& moves) {
+        moves.clear();
+        generate(first, second, moves);
+        std::sort(moves.moves.begin(), moves.moves.begin() + moves.size);
+        moves.size = std::unique(moves.moves.begin(), moves.moves.begin() + moves.size) - moves.moves.begin();
+    }
+
+    void Position::generate_afterstates(int first, int second, AfterstateList& afterstates) {
+        afterstates.clear();
+        generate(first, second, afterstates);
+    }
+
+    template <class List>
+    void Position::generate(int first, int second, List& list) {
+        CompactMove move;
+        uint64_t h = hash();
+        if (first == second) {
+            // the checker moves of a double can always be played back to front,
+            // so only that order is generated
+            int deltas[4] = {first, first, first, first};
+            for (int count = 4; count >= 1 && list.empty(); count--) {
+                generate(deltas, count, 0, BAR, h, move, list);
             }
         } else {
-            move.clear();
-            find_moves(deltas, 0, move, moves);
-            std::swap(deltas[0], deltas[1]);
-            move.clear();
-            find_moves(deltas, 0, move, moves);
-            if (moves.empty()) {
-                move.clear();
-                find_moves({std::max(deltas[0], deltas[1])}, 0, move, moves);
-                if (moves.empty()) {
-                    move.clear();
-                    find_moves({std::min(deltas[0], deltas[1])}, 0, move, moves);
+            int deltas[2] = {first, second};
+            int swapped[2] = {second, first};
+            generate(deltas, 2, 0, BAR, h, move, list);
+            generate(swapped, 2, 0, BAR, h, move, list);
+            if (list.empty()) {
+                int high = std::max(first, second);
+                int low = std::min(first, second);
+                generate(&high, 1, 0, BAR, h, move, list);
+                if (list.empty()) {
+                    generate(&low, 1, 0, BAR, h, move, list);
                 }
             }
         }
-        for (auto& m : moves) {
-            std::sort(m.begin(), m.end());
-        }
-        std::sort(moves.begin(), moves.end());
-        moves.erase(std::unique(moves.begin(), moves.end()), moves.end());
-        return moves;
     }
 
-    void State::find_moves(const Deltas& deltas, int index, Move& move, Moves& moves) {
-        if (index == (int)deltas.size()) {
-            moves.push_back(move);
+    template <class List>
+    void Position::generate(const int* deltas, int count, int index, int bound, uint64_t hash, CompactMove& move, List& list) {
+        if (index == count) {
+            CompactMove sorted = move;
+            sorted.sort();
+            if constexpr (std::is_same_v<List, AfterstateList>) {
+                list.insert(sorted, hash, *this);
+            } else {
+                list.push(sorted);
+            }
             return;
         }
         int delta = deltas[index];
         if (on[turn][BAR]) {
             int to = (turn == WHITE ? 24 : -1) + (turn == WHITE ? -1 : 1) * delta;
             if (to >= 0 && to < BOARD_SIZE && on[!turn][to] <= 1) {
-                CheckerMove checker_move(BAR, to);
-                make_move({checker_move});
-                move.push_back(checker_move);
-                find_moves(deltas, index + 1, move, moves);
-                move.pop_back();
-                undo_move();
+                uint64_t next = hash ^ touched_hash(BAR, to);
+                bool hit = make_checker_move(BAR, to);
+                next ^= touched_hash(BAR, to);
+                move.push(BAR, to);
+                generate(deltas, count, index + 1, bound, next, move, list);
+                move.pop();
+                undo_checker_move(BAR, to, hit);
             }
             return;
         }
         bool bear_off = can_bear_off();
+        bool doubles = deltas[0] == deltas[count - 1];
         for (int from = 0; from < BOARD_SIZE; from++) {
-            if (!on[turn][from]) continue;
+            if (!on[turn][from] || move_order(from) > bound) continue;
+            int order = doubles ? move_order(from) : bound;
             int to = from + (turn == WHITE ? -1 : 1) * delta;
             if (to >= 0 && to < BOARD_SIZE && on[!turn][to] <= 1) {
-                CheckerMove checker_move(from, to);
-                make_move({checker_move});
-                move.push_back(checker_move);
-                find_moves(deltas, index + 1, move, moves);
-                move.pop_back();
-                undo_move();
+                uint64_t next = hash ^ touched_hash(from, to);
+                bool hit = make_checker_move(from, to);
+                next ^= touched_hash(from, to);
+                move.push(from, to);
+                generate(deltas, count, index + 1, order, next, move, list);
+                move.pop();
+                undo_checker_move(from, to, hit);
             }
             if (bear_off && can_bear_off(from, delta)) {
-                CheckerMove checker_move(from, OUT);
-                make_move({checker_move});
-                move.push_back(checker_move);
-                find_moves(deltas, index + 1, move, moves);
-                move.pop_back();
-                undo_move();
+                uint64_t next = hash ^ touched_hash(from, OUT);
+                make_checker_move(from, OUT);
+                next ^= touched_hash(from, OUT);
+                move.push(from, OUT);
+                generate(deltas, count, index + 1, order, next, move, list);
+                move.pop();
+                undo_checker_move(from, OUT, false);
             }
         }
     }
 
-    bool State::can_bear_off() {
-        int cnt = 0;
-        for (auto point : home[turn]) {
-            cnt += on[turn][point];
+    uint64_t Position::hash() const {
+        uint64_t h = 0;
+        for (int player = 0; player <= 1; player++) {
+            for (int point = 0; point <= OUT; point++) {
+                h ^= ZOBRIST[player][point][on[player][point]];
+            }
         }
-        return cnt + on[turn][OUT] == 15;
+        return h;
     }
 
-    bool State::can_bear_off(int from, int delta) {
-        int direction = (turn == WHITE ? -1 : 1);
-        int bear_off_point = (turn == WHITE ? -1 : 24) - direction * delta;
-        if (from == bear_off_point) {
-            return true;
-        }
-        if ((turn == WHITE && from > bear_off_point) || (turn == BLACK && from < bear_off_point)) {
-            return false;
+    uint64_t Position::touched_hash(int from, int to) const {
+        // hash of every count a checker move from -> to can change
+        uint64_t h = ZOBRIST[turn][from][on[turn][from]] ^ ZOBRIST[turn][to][on[turn][to]];
+        if (to != OUT) {
+            h ^= ZOBRIST[!turn][to][on[!turn][to]] ^ ZOBRIST[!turn][BAR][on[!turn][BAR]];
         }
-        for (int point = (turn == WHITE ? 5 : 18); point != from; point += direction) {
-            if (on[turn][point]) {
-                return false;
-            }
+        return h;
+    }
+
+    bool Position::can_bear_off() const {
+        return back[turn] <= 6;
+    }
+
+    bool Position::can_bear_off(int from, int delta) const {
+        int d = distance(turn, from);
+        if (d == delta) {
+            return true;
         }
-        return true;
+        // a higher die may only bear off the furthest back checker
+        return d < delta && back[turn] == d;
     }
 
-    Outcome State::outcome(int player) const {
+    Outcome Position::outcome(int player) const {
         if (on[player][OUT] == 15) {
             if (on[!player][OUT]) {
                 return Outcome::WON_SINGLE_GAME;
@@ -215,54 +423,10 @@ namespace Backgammon {
         return Outcome::LOST_GAMMON;
     }
 
-    void State::show() const {
-        /*
-            |-----------------------------------|-----|-----------------------------------|-----|
-            | 013 | 014 | 015 | 016 | 017 | 018 |     | 019 | 020 | 021 | 022 | 023 | 024 | OUT |
-            |-----------------------------------|-----|-----------------------------------|-----|
-            |  #  |     |     |     |  +  |     |     |  +  |     |     |     |     |  #  |     |
-            |-----------------------------------|-BAR-|-----------------------------------|-----|
-            |  +  |     |     |     |  #  |     |     |  #  |     |     |     |     |  +  |     |
-            |-----------------------------------|-----|-----------------------------------|-----|
-            | 012 | 011 | 010 | 009 | 008 | 007 |     | 006 | 005 | 004 | 003 | 002 | 001 | OUT |
-            |-----------------------------------|-----|-----------------------------------|-----|
-        */
-        std::string white = "#";
-        std::string black = "O";
-        std::cout << "|-----------------------------------|-----|-----------------------------------|-----|" << std::endl;
-        std::cout << "| 013 | 014 | 015 | 016 | 017 | 018 |     | 019 | 020 | 021 | 022 | 023 | 024 | OUT |" << std::endl;
-        std::cout << "|-----------------------------------|-----|-----------------------------------|-----|" << std::endl;
-        for (int row = 0; row < 15; row++) {
-            std::cout << "|";
-            for (int point = 12; point < BOARD_SIZE; point++) {
-                std::cout << "  " << (on[WHITE][point] > row ? white : on[BLACK][point] > row ? black : " ") << "  |";
-                if (point == 17) {
-                    std::cout << "  " + std::string(on[WHITE][BAR] > 14 - row ? white : " ") + "  |";
-                }
-            }
-            std::cout << "  " << (on[BLACK][OUT] > row ? black : " ") << "  |" << std::endl;
-        }
-        std::cout << "|-----------------------------------|-BAR-|-----------------------------------|-----|" << std::endl;
-        for (int row = 14; row >= 0; row--) {
-            std::cout << "|";
-            for (int point = 11; point >= 0; point--) {
-                std::cout << "  " << (on[WHITE][point] > row ? white : on[BLACK][point] > row ? black : " ") << "  |";
-                if (point == 6) {
-                    std::cout << "  " + std::string(on[BLACK][BAR] > 14 - row ? black : " ") + "  |";
-                }
-            }
-            std::cout << "  " << (on[WHITE][OUT] > row ? white : " ") << "  |" << std::endl;
-        }
-        std::cout << "|-----------------------------------|-----|-----------------------------------|-----|" << std::endl;
-        std::cout << "| 012 | 011 | 010 | 009 | 008 | 007 |     | 006 | 005 | 004 | 003 | 002 | 001 | OUT |" << std::endl;
-        std::cout << "|-----------------------------------|-----|-----------------------------------|-----|" << std::endl;
-        std::cout << (turn == WHITE ? "White" : "Black") << "'s turn" << std::endl;
-    }
-
-    Dice::Dice() 
+    Dice::Dice(uint64_t seed, uint64_t stream) 
         : first(0),
         second(0),
-        uniform(std::uniform_int_distribution<>(1, 6)),
+        rng(seed, stream),
         first_throw(true) {}
     
     void Dice::roll() {
@@ -270,8 +434,8 @@ namespace Backgammon {
             first_throw = false;
             return;
         }
-        first = uniform(rng);
-        second = uniform(rng);
+        first = rng.uniform(6) + 1;
+        second = rng.uniform(6) + 1;
     }
 
     Deltas Dice::get_deltas() {
@@ -284,72 +448,72 @@ namespace Backgammon {
         return deltas;
     }
 
-    std::random_device Dice::rd = std::random_device();
-    std::mt19937 Dice::rng = std::mt19937(rd());
+    Game::Game(std::shared_ptr<Player> white, std::shared_ptr<Player> black, uint64_t seed) 
+        : Game(white, black, std::make_shared<Observer>(), seed) {}
 
-    Game::Game(std::shared_ptr<Player> white, std::shared_ptr<Player> black) {
+    Game::Game(
+        std::shared_ptr<Player> white, 
+        std::shared_ptr<Player> black, 
+        std::shared_ptr<Observer> observer, 
+        uint64_t seed
+    ) 
+        : observer(observer),
+          seed(seed),
+          games_played(0)
+    {
         points.fill(0);
         players[WHITE] = white;
         players[BLACK] = black;
     }
 
     void Game::play_turn() {
+        observer->turn_started(position);
         dice.roll();
-        state.show();
-        std::cout << "Dice: " << dice.first << " " << dice.second << std::endl;
-        Moves moves = state.get_moves(dice.get_deltas());
-        if (moves.empty()) {
-            players[state.turn]->no_moves(state);
-            state.turn = !state.turn;
+        observer->dice_rolled(dice);
+        position.generate_afterstates(dice.first, dice.second, afterstates);
+        if (afterstates.empty()) {
+            players[position.turn]->no_moves(position);
+            position.turn = !position.turn;
             return;
         }
-        int index = players[state.turn]->choose_move(state, dice, moves);
-        std::cout << "Moved the following checkers (from, to):" << std::endl;
-        for (auto [from, to] : moves[index]) {
-            std::cout << "(" << from + 1 << ", " << to + 1 << ")" << std::endl;
-        }
-        state.make_move(moves[index]);
-        state.turn = !state.turn;
+        int index = players[position.turn]->choose_move(position, dice, afterstates);
+        const CompactMove& move = afterstates[index].move;
+        observer->move_played(position, move);
+        history.push_back(position.make_move(move));
+        position.turn = !position.turn;
     }
 
     void Game::play() {
         players[WHITE]->new_game();
         players[BLACK]->new_game();
-        state = State();
-        dice = Dice();
+        position = Position();
+        history.clear();
+        dice = Dice(seed, games_played++);
         do {
             dice.roll();
         } while (dice.first == dice.second);
         dice.first_throw = true;
-        state.turn = dice.first < dice.second ? WHITE : BLACK;
+        position.turn = dice.first < dice.second ? WHITE : BLACK;
         while (true) {
             play_turn();
-            if (state.on[!state.turn][OUT] == 15) {
-                players[WHITE]->game_over(state, WHITE);
-                players[BLACK]->game_over(state, BLACK);
-                state.show();
-                Outcome outcome = state.outcome(WHITE);
-                std::string s;
+            if (position.on[!position.turn][OUT] == 15) {
+                players[WHITE]->game_over(position, WHITE);
+                players[BLACK]->game_over(position, BLACK);
+                Outcome outcome = position.outcome(WHITE);
                 if (outcome == Outcome::WON_SINGLE_GAME) {
-                    s = " won a single game";
                     points[WHITE] += 1;
                 } else if (outcome == Outcome::WON_GAMMON) {
-                    s = " won a gammon";
                     points[WHITE] += 2;
                 } else if (outcome == Outcome::WON_BACKGAMMON) {
-                    s = " won a backgammon";
                     points[WHITE] += 3;
                 } else if (outcome == Outcome::LOST_SINGLE_GAME) {
-                    s = " lost a single game";
                     points[BLACK] += 1;
                 } else if (outcome == Outcome::LOST_GAMMON) {
-                    s = " lost a gammon";
                     points[BLACK] += 2;
                 } else if (outcome == Outcome::LOST_BACKGAMMON) {
-                    s = " lost a backgammon";
                     points[BLACK] += 3;
                 }
-                std::cout << "White" << s << std::endl;
+                observer->game_over(position, outcome);
                 break;
             }
         }
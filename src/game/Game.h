@@ -8,10 +8,10 @@
 #include <cassert>
 #include <algorithm>
 #include <memory>
-#include <set>
-#include <stack>
+#include <cstdint>
 
 #include "../player/Player.h"
+#include "../RevGrad/utill/Random.h"
 
 namespace Backgammon {
     #define WHITE 0
@@ -19,6 +19,10 @@ namespace Backgammon {
     #define BAR 24
     #define OUT 25
     #define BOARD_SIZE 24
+    #define MAX_CHECKER_MOVES 4
+    #define MAX_MOVES 4096
+    #define MAX_AFTERSTATES 2048
+    #define AFTERSTATE_TABLE_SIZE 4096
 
     enum Outcome { 
         WON_SINGLE_GAME, 
@@ -30,15 +34,21 @@ namespace Backgammon {
     };
     
     class Player;
+    class Observer;
     class CheckerMove;
-    class State;
+    class CompactCheckerMove;
+    class CompactMove;
+    class MoveList;
+    class UndoRecord;
+    class Position;
+    class Afterstate;
+    class AfterstateList;
     class Dice;
     class Game;
 
     typedef std::vector<CheckerMove> Move;
     typedef std::vector<Move> Moves;
     typedef std::vector<int> Deltas;
-    typedef std::vector<std::pair<int, CheckerMove>> Undo;
     
     class CheckerMove {
     public:
@@ -50,37 +60,135 @@ namespace Backgammon {
     bool operator<(const CheckerMove& a, const CheckerMove& b);
     bool operator==(const CheckerMove& a, const CheckerMove& b);
 
-    class State {
+    class CompactCheckerMove {
     public:
-        int turn;
-        std::array<std::array<int, 6>, 2> home = {
+        int8_t from;
+        int8_t to;
+    };
+
+    class CompactMove {
+    public:
+        std::array<CompactCheckerMove, MAX_CHECKER_MOVES> checker_moves;
+        int8_t size = 0;
+        void push(int from, int to);
+        void pop();
+        void sort();
+        Move to_move() const;
+    };
+
+    bool operator<(const CompactCheckerMove& a, const CompactCheckerMove& b);
+    bool operator==(const CompactCheckerMove& a, const CompactCheckerMove& b);
+    bool operator<(const CompactMove& a, const CompactMove& b);
+    bool operator==(const CompactMove& a, const CompactMove& b);
+
+    /*
+        Fixed capacity list of moves, meant to live on the stack
+    */
+    class MoveList {
+    public:
+        std::array<CompactMove, MAX_MOVES> moves;
+        int size = 0;
+        void clear();
+        bool empty() const;
+        void push(const CompactMove& move);
+        CompactMove& operator[](int index);
+        const CompactMove& operator[](int index) const;
+    };
+
+    /*
+        Everything needed to take back a CompactMove,
+        bit i of hits is set if checker move i hit a blot
+    */
+    class UndoRecord {
+    public:
+        CompactMove move;
+        uint8_t hits = 0;
+    };
+
+    /*
+        The board and the player to move, nothing else,
+        so copying a position is a plain 60 byte copy.
+        pip and back are kept up to date by make_checker_move and undo_checker_move,
+        back is the distance of a player's furthest back checker (25 on the bar, 0 when all are off)
+    */
+    class Position {
+    public:
+        static constexpr std::array<std::array<int, 6>, 2> home = {
             std::array<int, 6>{5, 4, 3, 2, 1, 0},
             std::array<int, 6>{18, 19, 20, 21, 22, 23}
         };
-        std::array<std::array<int, 26>, 2> on;
-        std::stack<Undo> made;
-        State();
+        std::array<int16_t, 2> pip;
+        std::array<std::array<int8_t, 26>, 2> on;
+        int8_t turn;
+        std::array<int8_t, 2> back;
+        Position();
+        void refresh();
+        static int distance(int player, int point);
+        int furthest(int player, int distance) const;
         int compute_pip(int player) const;
         bool race() const;
-        void make_move(Move move);
-        void undo_move();
-        Moves get_moves(Deltas deltas);
-        void find_moves(const Deltas& deltas, int index, Move& move, Moves& moves);
-        bool can_bear_off();
-        bool can_bear_off(int from, int delta);
+        bool make_checker_move(int from, int to);
+        void undo_checker_move(int from, int to, bool hit);
+        UndoRecord make_move(const CompactMove& move);
+        void undo_move(const UndoRecord& undo);
+        void generate_moves(int first, int second, MoveList& moves);
+        void generate_afterstates(int first, int second, AfterstateList& afterstates);
+        template <class List>
+        void generate(int first, int second, List& list);
+        template <class List>
+        void generate(const int* deltas, int count, int index, int bound, uint64_t hash, CompactMove& move, List& list);
+        int move_order(int from) const;
+        uint64_t hash() const;
+        uint64_t touched_hash(int from, int to) const;
+        bool can_bear_off() const;
+        bool can_bear_off(int from, int delta) const;
         Outcome outcome(int player) const;
-        void show() const;
+    };
+
+    bool operator==(const Position& a, const Position& b);
+
+    /*
+        The moves made so far in a game, kept apart from Position
+        so positions stay cheap to copy
+    */
+    typedef std::vector<UndoRecord> History;
+
+    /*
+        A distinct position reachable with the dice, with the turn already passed on
+    */
+    class Afterstate {
+    public:
+        CompactMove move;
+        uint64_t hash;
+        Position position;
+    };
+
+    /*
+        Fixed capacity list of distinct resulting positions, each with a move producing it.
+        Duplicates are detected through an open addressing table of Zobrist hashes
+    */
+    class AfterstateList {
+    public:
+        std::array<Afterstate, MAX_AFTERSTATES> afterstates;
+        int size = 0;
+        std::array<uint64_t, AFTERSTATE_TABLE_SIZE> table;
+        std::array<int, MAX_AFTERSTATES> slots;
+        AfterstateList();
+        void clear();
+        bool empty() const;
+        bool insert(const CompactMove& move, uint64_t hash, const Position& position);
+        int find(uint64_t hash) const;
+        Afterstate& operator[](int index);
+        const Afterstate& operator[](int index) const;
     };
 
     class Dice {
     public:
         int first;
         int second;
-        static std::random_device rd;
-        static std::mt19937 rng;
-        std::uniform_int_distribution<> uniform;
+        RevGrad::Random rng;
         bool first_throw;
-        Dice();
+        Dice(uint64_t seed = 0, uint64_t stream = 0);
         void roll();
         Deltas get_deltas();
     };
@@ -88,10 +196,24 @@ namespace Backgammon {
     class Game {
     public:
         std::array<int, 2> points;
-        State state;
+        Position position;
+        History history;
         Dice dice;
+        AfterstateList afterstates;
         std::array<std::shared_ptr<Player>, 2> players;
-        Game(std::shared_ptr<Player> white, std::shared_ptr<Player> black);
+        std::shared_ptr<Observer> observer;
+        /*
+            game i is played with stream i of seed, set games_played to replay a game
+        */
+        uint64_t seed;
+        uint64_t games_played;
+        Game(std::shared_ptr<Player> white, std::shared_ptr<Player> black, uint64_t seed = 0);
+        Game(
+            std::shared_ptr<Player> white, 
+            std::shared_ptr<Player> black, 
+            std::shared_ptr<Observer> observer, 
+            uint64_t seed = 0
+        );
         void play_turn();
         void play();
     };
@@ -0,0 +1,84 @@
+#include "Observer.h"
+
+namespace Backgammon {
+    ConsoleObserver::ConsoleObserver(std::ostream& os) : os(os) {}
+
+    void ConsoleObserver::show(const Position& position) const {
+        /*
+            |-----------------------------------|-----|-----------------------------------|-----|
+            | 013 | 014 | 015 | 016 | 017 | 018 |     | 019 | 020 | 021 | 022 | 023 | 024 | OUT |
+            |-----------------------------------|-----|-----------------------------------|-----|
+            |  #  |     |     |     |  +  |     |     |  +  |     |     |     |     |  #  |     |
+            |-----------------------------------|-BAR-|-----------------------------------|-----|
+            |  +  |     |     |     |  #  |     |     |  #  |     |     |     |     |  +  |     |
+            |-----------------------------------|-----|-----------------------------------|-----|
+            | 012 | 011 | 010 | 009 | 008 | 007 |     | 006 | 005 | 004 | 003 | 002 | 001 | OUT |
+            |-----------------------------------|-----|-----------------------------------|-----|
+        */
+        std::string white = "#";
+        std::string black = "O";
+        os << "|-----------------------------------|-----|-----------------------------------|-----|\n";
+        os << "| 013 | 014 | 015 | 016 | 017 | 018 |     | 019 | 020 | 021 | 022 | 023 | 024 | OUT |\n";
+        os << "|-----------------------------------|-----|-----------------------------------|-----|\n";
+        for (int row = 0; row < 15; row++) {
+            os << "|";
+            for (int point = 12; point < BOARD_SIZE; point++) {
+                os << "  " << (position.on[WHITE][point] > row ? white : position.on[BLACK][point] > row ? black : " ") << "  |";
+                if (point == 17) {
+                    os << "  " + std::string(position.on[WHITE][BAR] > 14 - row ? white : " ") + "  |";
+                }
+            }
+            os << "  " << (position.on[BLACK][OUT] > row ? black : " ") << "  |\n";
+        }
+        os << "|-----------------------------------|-BAR-|-----------------------------------|-----|\n";
+        for (int row = 14; row >= 0; row--) {
+            os << "|";
+            for (int point = 11; point >= 0; point--) {
+                os << "  " << (position.on[WHITE][point] > row ? white : position.on[BLACK][point] > row ? black : " ") << "  |";
+                if (point == 6) {
+                    os << "  " + std::string(position.on[BLACK][BAR] > 14 - row ? black : " ") + "  |";
+                }
+            }
+            os << "  " << (position.on[WHITE][OUT] > row ? white : " ") << "  |\n";
+        }
+        os << "|-----------------------------------|-----|-----------------------------------|-----|\n";
+        os << "| 012 | 011 | 010 | 009 | 008 | 007 |     | 006 | 005 | 004 | 003 | 002 | 001 | OUT |\n";
+        os << "|-----------------------------------|-----|-----------------------------------|-----|\n";
+        os << (position.turn == WHITE ? "White" : "Black") << "'s turn\n";
+    }
+
+
+    void ConsoleObserver::turn_started(const Position& position) {
+        show(position);
+    }
+
+    void ConsoleObserver::dice_rolled(const Dice& dice) {
+        os << "Dice: " << dice.first << " " << dice.second << "\n";
+    }
+
+    void ConsoleObserver::move_played(const Position& position, const CompactMove& move) {
+        os << "Moved the following checkers (from, to):\n";
+        for (auto [from, to] : move.to_move()) {
+            os << "(" << from + 1 << ", " << to + 1 << ")\n";
+        }
+    }
+
+    void ConsoleObserver::game_over(const Position& position, Outcome outcome) {
+        show(position);
+        std::string s;
+        if (outcome == Outcome::WON_SINGLE_GAME) {
+            s = " won a single game";
+        } else if (outcome == Outcome::WON_GAMMON) {
+            s = " won a gammon";
+        } else if (outcome == Outcome::WON_BACKGAMMON) {
+            s = " won a backgammon";
+        } else if (outcome == Outcome::LOST_SINGLE_GAME) {
+            s = " lost a single game";
+        } else if (outcome == Outcome::LOST_GAMMON) {
+            s = " lost a gammon";
+        } else if (outcome == Outcome::LOST_BACKGAMMON) {
+            s = " lost a backgammon";
+        }
+        os << "White" << s << std::endl;
+    }
+}
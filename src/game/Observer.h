@@ -0,0 +1,33 @@
+#ifndef OBSERVER_H
+#define OBSERVER_H
+
+#include "Game.h"
+
+namespace Backgammon {
+    /*
+        Receives the events of a game, the default does nothing
+    */
+    class Observer {
+    public:
+        virtual void turn_started(const Position& position) {}
+        virtual void dice_rolled(const Dice& dice) {}
+        virtual void move_played(const Position& position, const CompactMove& move) {}
+        virtual void game_over(const Position& position, Outcome outcome) {}
+    };
+
+    /*
+        Draws the board and the moves as text
+    */
+    class ConsoleObserver : public Observer {
+    public:
+        std::ostream& os;
+        ConsoleObserver(std::ostream& os = std::cout);
+        void show(const Position& position) const;
+        void turn_started(const Position& position) override;
+        void dice_rolled(const Dice& dice) override;
+        void move_played(const Position& position, const CompactMove& move) override;
+        void game_over(const Position& position, Outcome outcome) override;
+    };
+}
+
+#endif
@@ -1,126 +1,398 @@
 #include "Model.h"
 
 #define INPUT_FEATURES 201
+#define PLAYER_FEATURES 97 // 4 for each point and the pip count
+#define PIP_FEATURE 96
+#define BAR_FEATURE 194
+#define OFF_FEATURE 196
+#define TURN_FEATURE 198
+#define RACE_FEATURE 200
+#define CALIBRATION_GAMES 100
 
 namespace Backgammon {
-    NeuralNetwork::NeuralNetwork(int hidden_units) {
-        l1 = RevGrad::Linear(this, INPUT_FEATURES, hidden_units);
-        l2 = RevGrad::Linear(this, hidden_units, 1);
+    NeuralNetwork::NeuralNetwork(int hidden_units, uint64_t seed) {
+        RevGrad::Random rng(seed);
+        l1 = RevGrad::Linear(this, INPUT_FEATURES, hidden_units, rng, RevGrad::Activation::RELU);
+        l2 = RevGrad::Linear(this, hidden_units, 1, rng, RevGrad::Activation::SIGMOID);
     }
 
     RevGrad::Tensor NeuralNetwork::forward(RevGrad::Tensor x) {
+        // both layers apply their activation in the same op
         x = l1(x);
-        x = RevGrad::Tensor::relu(x);
         x = l2(x);
-        x = RevGrad::Tensor::sigmoid(x);
         return x;
     }
 
-    Model::Model(int hidden_units) : nn(NeuralNetwork(hidden_units)) {}
+    Model::Model(int hidden_units, uint64_t seed, Backend backend) 
+        : nn(NeuralNetwork(hidden_units, seed)),
+          seed(seed),
+          backend(backend),
+          value_network(ValueNetwork::create(INPUT_FEATURES, hidden_units)),
+          features(INPUT_FEATURES * MAX_AFTERSTATES),
+          values(MAX_AFTERSTATES),
+          root_accumulator(hidden_units),
+          accumulator(hidden_units)
+    {
+        value_network->read(nn);
+        for (auto param : nn.get_params()) {
+            traces.emplace_back(param.size(), 0.0f);
+        }
+    }
+
+    void Model::save(std::string filename) {
+        if (backend == Backend::ANALYTIC) {
+            value_network->write(nn);
+        }
+        nn.save_parameters(filename);
+    }
+
+    void Model::load(std::string filename) {
+        nn.load_parameters(filename);
+        value_network->read(nn);
+        // made from the new weights when next needed
+        quantized_network.reset();
+    }
+
+    bool Model::game_over(const Position& next, float& reward) {
+        if (next.on[WHITE][OUT] != 15 && next.on[BLACK][OUT] != 15) {
+            return false;
+        }
+        Outcome outcome = next.outcome(WHITE);
+        reward = (
+            outcome == Outcome::WON_SINGLE_GAME ||
+            outcome == Outcome::WON_GAMMON ||
+            outcome == Outcome::WON_BACKGAMMON
+        ) ? 1.0f : 0.0f;
+        return true;
+    }
 
-    void Model::save(std::string filename) { nn.save_parameters(filename); }
-    void Model::load(std::string filename) { nn.load_parameters(filename); }
+    static void point_features(int n, float* values) {
+        values[0] = n >= 1 ? 1.0f : 0.0f;
+        values[1] = n >= 2 ? 1.0f : 0.0f;
+        values[2] = n >= 3 ? 1.0f : 0.0f;
+        values[3] = n >= 3 ? (n - 3.0f) / 2.0f : 0.0f;
+    }
 
-    RevGrad::Tensor Model::tensor_from_state(const State& state) {
-        std::vector<float> values;
-        values.reserve(INPUT_FEATURES);
+    /*
+        Calls push(feature, value) for every input feature of position, in order
+    */
+    template <class Push>
+    static void encode_features(const Position& position, Push push_feature) {
+        int feature = 0;
+        auto push = [&] (float value) {
+            push_feature(feature++, value);
+        };
         for (int player = 0; player <= 1; player++) {
             for (int point = 0; point < BOARD_SIZE; point++) {
-                int n = state.on[player][point];
-                if (n == 0) {
-                    values.push_back(0.0f);
-                    values.push_back(0.0f);
-                    values.push_back(0.0f);
-                    values.push_back(0.0f);
-                    continue;
-                }
-                if (n == 1) {
-                    values.push_back(1.0f);
-                    values.push_back(0.0f);
-                    values.push_back(0.0f);
-                    values.push_back(0.0f);
-                    continue;
-                }
-                if (n == 2) {
-                    values.push_back(1.0f);
-                    values.push_back(1.0f);
-                    values.push_back(0.0f);
-                    values.push_back(0.0f);
-                    continue;
+                float values[4];
+                point_features(position.on[player][point], values);
+                for (float value : values) {
+                    push(value);
                 }
-                values.push_back(1.0f);
-                values.push_back(1.0f);
-                values.push_back(1.0f);
-                values.push_back((n - 3.0f) / 2.0f);
             }
-            values.push_back(state.compute_pip(player) / 375.0f);
+            push(position.compute_pip(player) / 375.0f);
         }
         for (int player = 0; player <= 1; player++) {
-            values.push_back(state.on[player][BAR] / 2.0f);
+            push(position.on[player][BAR] / 2.0f);
         }
         for (int player = 0; player <= 1; player++) {
-            values.push_back(state.on[player][OUT] / 15.0f);
+            push(position.on[player][OUT] / 15.0f);
         }
-        if (state.turn == WHITE) {
-            values.push_back(1.0f);
-            values.push_back(0.0f);
-        } else {
-            values.push_back(0.0f);
-            values.push_back(1.0f);
+        push(position.turn == WHITE ? 1.0f : 0.0f);
+        push(position.turn == WHITE ? 0.0f : 1.0f);
+        assert(feature == RACE_FEATURE);
+        push(position.race());
+        assert(feature == INPUT_FEATURES);
+    }
+
+    /*
+        Fills delta with the features of next that differ from x, 
+        where next is reached from the position encoded in x by player making move.
+        Only the points the move touches and the counts it can change are looked at
+    */
+    static void encode_delta(
+        const Position& next, 
+        const CompactMove& move, 
+        int player, 
+        const float* x, 
+        SparseInput& delta
+    ) {
+        delta.clear();
+        auto compare = [&] (int first, const float* values, int count) {
+            for (int i = 0; i < count; i++) {
+                float difference = values[i] - x[first + i];
+                if (difference != 0.0f) {
+                    delta.push(first + i, difference);
+                }
+            }
+        };
+        std::array<uint32_t, 2> seen = {0, 0};
+        auto compare_point = [&] (int owner, int point) {
+            if (point >= BOARD_SIZE || (seen[owner] >> point & 1)) {
+                return;
+            }
+            seen[owner] |= 1u << point;
+            float values[4];
+            point_features(next.on[owner][point], values);
+            compare(owner * PLAYER_FEATURES + point * 4, values, 4);
+        };
+        for (int i = 0; i < move.size; i++) {
+            auto [from, to] = move.checker_moves[i];
+            compare_point(player, from);
+            compare_point(player, to);
+            compare_point(!player, to); // a hit
+        }
+        for (int owner = 0; owner <= 1; owner++) {
+            float pip = next.compute_pip(owner) / 375.0f;
+            float bar = next.on[owner][BAR] / 2.0f;
+            float off = next.on[owner][OUT] / 15.0f;
+            compare(owner * PLAYER_FEATURES + PIP_FEATURE, &pip, 1);
+            compare(BAR_FEATURE + owner, &bar, 1);
+            compare(OFF_FEATURE + owner, &off, 1);
         }
-        values.push_back(state.race());
-        assert((int)values.size() == INPUT_FEATURES);
+        float race = next.race();
+        compare(RACE_FEATURE, &race, 1);
+    }
+
+    void Model::encode(const Position& position, float* x, int stride) {
+        encode_features(position, [&] (int feature, float value) {
+            x[stride * feature] = value;
+        });
+    }
+
+    void Model::encode(const Position& position, SparseInput& x) {
+        x.clear();
+        encode_features(position, [&] (int feature, float value) {
+            if (value != 0.0f) {
+                x.push(feature, value);
+            }
+        });
+    }
+
+    RevGrad::Tensor Model::tensor_from_state(const Position& position) {
+        RevGrad::Values values(INPUT_FEATURES);
+        encode(position, values.data(), 1);
         return RevGrad::Tensor(RevGrad::Shape({INPUT_FEATURES, 1}), values);
     }
 
-    int Model::choose_move(const State& state, const Dice& dice, const Moves& moves) {
+    RevGrad::Tensor Model::tensor_from_afterstates(const AfterstateList& afterstates) {
+        // one column per afterstate
+        int n = afterstates.size;
+        RevGrad::Values values(INPUT_FEATURES * n);
+        for (int i = 0; i < n; i++) {
+            encode(afterstates[i].position, values.data() + i, n);
+        }
+        return RevGrad::Tensor(RevGrad::Shape({INPUT_FEATURES, n}), values);
+    }
+
+    const float* Model::evaluate(const Position& position, const AfterstateList& afterstates, Backend backend) {
+        cached = false;
+        if (backend == Backend::QUANTIZED) {
+            QuantizedNetwork& network = quantized();
+            for (int i = 0; i < afterstates.size; i++) {
+                encode(afterstates[i].position, sparse_features);
+                values[i] = network.forward(sparse_features);
+            }
+        } else if (backend == Backend::ANALYTIC && sparse && incremental) {
+            // the afterstates are encoded as changes to the position with the turn passed on
+            Position root = position;
+            root.turn = !position.turn;
+            float* x = features.data();
+            encode(root, x, 1);
+            encode(root, sparse_features);
+            value_network->accumulate(sparse_features, root_accumulator.data());
+            Position next = position;
+            for (int i = 0; i < afterstates.size; i++) {
+                UndoRecord undo = next.make_move(afterstates[i].move);
+                encode_delta(next, afterstates[i].move, position.turn, x, sparse_next);
+                next.undo_move(undo);
+                std::copy(root_accumulator.begin(), root_accumulator.end(), accumulator.begin());
+                value_network->add(sparse_next, accumulator.data());
+                values[i] = value_network->value(accumulator.data());
+            }
+        } else if (backend == Backend::ANALYTIC && sparse) {
+            for (int i = 0; i < afterstates.size; i++) {
+                encode(afterstates[i].position, sparse_features);
+                values[i] = value_network->forward(sparse_features);
+            }
+        } else if (backend == Backend::ANALYTIC) {
+            int n = afterstates.size;
+            for (int i = 0; i < n; i++) {
+                encode(afterstates[i].position, features.data() + i, n);
+            }
+            value_network->evaluate(features.data(), n, values.data());
+        } else {
+            // all afterstates are evaluated in one forward pass
+            RevGrad::Arena::Scope scope(arena);
+            RevGrad::NoGrad no_grad;
+            RevGrad::Tensor output = nn.forward(tensor_from_afterstates(afterstates));
+            std::copy(output.values().begin(), output.values().end(), values.begin());
+        }
+        return values.data();
+    }
+
+    int Model::choose_move(const Position& position, const Dice& dice, const AfterstateList& afterstates) {
+        const float* probabilities = evaluate(position, afterstates, backend);
         int index = 0;
-        float best_probability = state.turn == WHITE ? 
-            std::numeric_limits<float>::lowest() : 
-            std::numeric_limits<float>::max();
-        State s = state;
-        for (int i = 0; i < (int)moves.size(); i++) {
-            s.make_move(moves[i]);
-            s.turn = !s.turn;
-            float probability = predict(s).values()[0];
-            s.undo_move();
-            s.turn = !s.turn;
+        for (int i = 1; i < afterstates.size; i++) {
             if (
-                (s.turn == WHITE && best_probability < probability) ||
-                (s.turn == BLACK && best_probability > probability)
+                (position.turn == WHITE && probabilities[index] < probabilities[i]) ||
+                (position.turn == BLACK && probabilities[index] > probabilities[i])
             ) {
-                best_probability = probability;
                 index = i;
             }
         }
+        cached = true;
+        cached_accumulator = backend == Backend::ANALYTIC && sparse && incremental;
+        cached_position = position;
+        chosen = afterstates[index].position;
+        chosen_value = probabilities[index];
         return index;
     }
 
-    void Model::new_game() {}
+    std::vector<Position> Model::sample_positions(int games, uint64_t seed) {
+        std::vector<Position> positions;
+        RevGrad::Random rng(seed);
+        std::unique_ptr<AfterstateList> afterstates = std::make_unique<AfterstateList>();
+        for (int game = 0; game < games; game++) {
+            Position position;
+            position.turn = rng.uniform(2);
+            while (position.on[WHITE][OUT] != 15 && position.on[BLACK][OUT] != 15) {
+                positions.push_back(position);
+                int first = rng.uniform(6) + 1;
+                int second = rng.uniform(6) + 1;
+                position.generate_afterstates(first, second, *afterstates);
+                if (afterstates->empty()) {
+                    position.turn = !position.turn;
+                    continue;
+                }
+                const float* probabilities = evaluate(position, *afterstates, Backend::ANALYTIC);
+                int index = 0;
+                for (int i = 1; i < afterstates->size; i++) {
+                    if (
+                        (position.turn == WHITE && probabilities[index] < probabilities[i]) ||
+                        (position.turn == BLACK && probabilities[index] > probabilities[i])
+                    ) {
+                        index = i;
+                    }
+                }
+                position = (*afterstates)[index].position;
+            }
+        }
+        return positions;
+    }
 
-    RevGrad::Tensor Model::predict(const State& state) {
-        return nn.forward(tensor_from_state(state));
+    void Model::quantize(const std::vector<Position>& positions) {
+        // the pip counts and borne off counts are not multiples of 1 / INPUT_SCALE
+        std::vector<int> continuous = {
+            WHITE * PLAYER_FEATURES + PIP_FEATURE,
+            BLACK * PLAYER_FEATURES + PIP_FEATURE,
+            OFF_FEATURE + WHITE,
+            OFF_FEATURE + BLACK
+        };
+        quantized_network = std::make_unique<QuantizedNetwork>(*value_network, continuous);
+        for (const Position& position : positions) {
+            encode(position, sparse_features);
+            quantized_network->observe(sparse_features);
+        }
+        quantized_network->quantize();
+        if (quantized_network->saturated) {
+            std::cout << "Quantization clamped " << quantized_network->saturated << " first layer weights" << std::endl;
+        }
     }
 
-    void Model::update(const State& state, const Move& move) {
-        float alpha = 0.1f;
-        float error = 0.0f;
-        State next = state;
-        next.make_move(move);
-        next.turn = !next.turn;
-        RevGrad::Tensor prediction = predict(state);
-        if (next.on[WHITE][OUT] == 15 || next.on[BLACK][OUT] == 15) {
-            Outcome outcome = next.outcome(WHITE);
-            if (
-                outcome == Outcome::WON_SINGLE_GAME ||
-                outcome == Outcome::WON_GAMMON ||
-                outcome == Outcome::WON_BACKGAMMON
-            ) {
-                error = 1 - prediction.values()[0];
+    QuantizedNetwork& Model::quantized() {
+        if (!quantized_network) {
+            quantize(sample_positions(CALIBRATION_GAMES, seed));
+        }
+        return *quantized_network;
+    }
+
+    void Model::new_game() {
+        cached = false;
+        if (backend == Backend::ANALYTIC) {
+            value_network->reset_trace();
+        } else if (backend == Backend::REVGRAD) {
+            for (auto& trace : traces) {
+                std::fill(trace.begin(), trace.end(), 0.0f);
+            }
+        }
+    }
+
+    RevGrad::Tensor Model::predict(const Position& position) {
+        return nn.forward(tensor_from_state(position));
+    }
+
+    void Model::update(const Position& position, const Position& next) {
+        assert(backend != Backend::QUANTIZED); // inference only
+        float reward = 0.0f;
+        // the weights change below
+        bool reuse = cached;
+        cached = false;
+        bool reuse_value = reuse && next == chosen;
+        if (backend == Backend::ANALYTIC && sparse) {
+            if (!game_over(next, reward)) {
+                if (reuse_value) {
+                    reward = chosen_value;
+                } else {
+                    encode(next, sparse_next);
+                    reward = value_network->forward(sparse_next);
+                }
+            }
+            encode(position, sparse_features);
+            float prediction;
+            if (reuse && cached_accumulator && position == cached_position) {
+                // the root of the incremental evaluation is position with the turn passed on
+                float white = position.turn == WHITE ? 1.0f : -1.0f;
+                sparse_next.clear();
+                sparse_next.push(TURN_FEATURE, white);
+                sparse_next.push(TURN_FEATURE + 1, -white);
+                std::copy(root_accumulator.begin(), root_accumulator.end(), accumulator.begin());
+                value_network->add(sparse_next, accumulator.data());
+                prediction = value_network->activate(accumulator.data());
+            } else {
+                prediction = value_network->forward(sparse_features);
+            }
+            if (lambda == 0.0f) {
+                // no trace needed, the step only touches the columns of the non-zero inputs
+                value_network->step(sparse_features, alpha * (reward - prediction));
             } else {
-                error = 0 - prediction.values()[0];
+                value_network->trace(sparse_features, lambda);
+                value_network->step_trace(alpha * (reward - prediction));
             }
+            return;
+        }
+        if (backend == Backend::ANALYTIC) {
+            float* x = features.data();
+            float* x_next = x + INPUT_FEATURES;
+            if (!game_over(next, reward)) {
+                if (reuse_value) {
+                    reward = chosen_value;
+                } else {
+                    encode(next, x_next, 1);
+                    reward = value_network->forward(x_next);
+                }
+            }
+            // the last forward must be the one of position for step
+            encode(position, x, 1);
+            float prediction = value_network->forward(x);
+            if (lambda == 0.0f) {
+                value_network->step(x, alpha * (reward - prediction));
+            } else {
+                value_network->trace(x, lambda);
+                value_network->step_trace(alpha * (reward - prediction));
+            }
+            return;
+        }
+        RevGrad::Arena::Scope scope(arena);
+        float error = 0.0f;
+        RevGrad::Tensor prediction = predict(position);
+        if (game_over(next, reward)) {
+            error = reward - prediction.values()[0];
+        } else if (reuse_value) {
+            error = chosen_value - prediction.values()[0];
         } else {
+            RevGrad::NoGrad no_grad;
             error = predict(next).values()[0] - prediction.values()[0];
         }
         // Zero the gradients
@@ -131,11 +403,74 @@ namespace Backgammon {
         }
         // Compute the gradients
         prediction.backward();
-        // Update the values
-        for (auto param : nn.get_params()) {
+        // Update the traces and the values
+        std::vector<RevGrad::Tensor> params = nn.get_params();
+        for (int k = 0; k < (int)params.size(); k++) {
+            RevGrad::Tensor& param = params[k];
+            std::vector<float>& trace = traces[k];
             for (int i = 0; i < param.size(); i++) {
-                param.values()[i] += alpha * error * param.grads()[i];
+                trace[i] = lambda * trace[i] + param.grads()[i];
+                param.values()[i] += alpha * error * trace[i];
             }
         }
     }
+
+    void Model::evaluate(const float* x, int n, float* out) {
+        if (backend == Backend::ANALYTIC) {
+            value_network->evaluate(x, n, out);
+            return;
+        }
+        assert(backend == Backend::REVGRAD);
+        RevGrad::Arena::Scope scope(arena);
+        RevGrad::NoGrad no_grad;
+        RevGrad::Tensor input(
+            RevGrad::Shape({INPUT_FEATURES, n}), 
+            RevGrad::Values(x, x + INPUT_FEATURES * n)
+        );
+        RevGrad::Tensor output = nn.forward(input);
+        std::copy(output.values().begin(), output.values().end(), out);
+    }
+
+    void Model::update(const float* x, const float* targets, int n, float step_size) {
+        assert(backend != Backend::QUANTIZED); // inference only
+        cached = false;
+        if (backend == Backend::ANALYTIC) {
+            value_network->write(nn);
+        }
+        {
+            RevGrad::Arena::Scope scope(arena);
+            RevGrad::Tensor input;
+            {
+                // no gradient is needed at the input, so backward skips it
+                RevGrad::NoGrad no_grad;
+                input = RevGrad::Tensor(
+                    RevGrad::Shape({INPUT_FEATURES, n}), 
+                    RevGrad::Values(x, x + INPUT_FEATURES * n)
+                );
+            }
+            RevGrad::Tensor prediction = nn.forward(input);
+            // the gradient of minus half the mean squared error at the predictions
+            errors.resize(n);
+            for (int i = 0; i < n; i++) {
+                errors[i] = (targets[i] - prediction.values()[i]) / n;
+            }
+            std::vector<RevGrad::Tensor> params = nn.get_params();
+            for (auto& param : params) {
+                std::fill(param.grads().begin(), param.grads().end(), 0.0f);
+            }
+            prediction.backward(errors);
+            for (auto& param : params) {
+                int size = param.size();
+                float* values = param.values().data();
+                const float* grads = param.grads().data();
+                #pragma omp simd
+                for (int i = 0; i < size; i++) {
+                    values[i] += step_size * grads[i];
+                }
+            }
+        }
+        if (backend == Backend::ANALYTIC) {
+            value_network->read(nn);
+        }
+    }
 }
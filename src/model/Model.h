@@ -4,29 +4,122 @@
 #include "../RevGrad/model/Model.h"
 #include "../RevGrad/utill/Print.h"
 #include "../player/Player.h"
+#include "ValueNetwork.h"
+#include "QuantizedNetwork.h"
 
 namespace Backgammon {
     typedef std::vector<std::pair<float, Move>> ScoreMoves;
 
+    /*
+        REVGRAD runs the network through the autograd library, 
+        ANALYTIC through the hand written ValueNetwork. Both give the same values.
+        QUANTIZED evaluates with a QuantizedNetwork made from the weights, 
+        it can not be trained
+    */
+    enum class Backend {
+        REVGRAD,
+        ANALYTIC,
+        QUANTIZED
+    };
+
     class NeuralNetwork : public RevGrad::Model {
     public:
         RevGrad::Linear l1;
         RevGrad::Linear l2;
-        NeuralNetwork(int hidden_units);
+        NeuralNetwork(int hidden_units, uint64_t seed);
         RevGrad::Tensor forward(RevGrad::Tensor x);
     };
 
     class Model {
     public:
         NeuralNetwork nn;
-        Model(int hidden_units);
+        uint64_t seed; // of the weights, also of the calibration games of quantized
+        /*
+            Holds the tensors of one choose_move or update, the parameters are not in it
+        */
+        RevGrad::Arena arena;
+        Backend backend;
+        std::unique_ptr<ValueNetwork> value_network;
+        std::unique_ptr<QuantizedNetwork> quantized_network;
+        /*
+            The ANALYTIC backend feeds the first layer only the non-zero features when set,
+            and the dense encoding otherwise
+        */
+        bool sparse = true;
+        std::vector<float> features; // encoded positions of the ANALYTIC backend
+        SparseInput sparse_features;
+        SparseInput sparse_next;
+        std::vector<float> values;
+        /*
+            With sparse set, choose_move evaluates the afterstates by updating
+            the first layer pre-activations of the position instead of from scratch
+        */
+        bool incremental = true;
+        std::vector<float> root_accumulator;
+        std::vector<float> accumulator;
+        /*
+            What the last choose_move found, so update does not evaluate it again:
+            the value of the chosen afterstate, and with the incremental evaluation 
+            the first layer pre-activations of the position. Valid until the weights change
+        */
+        bool cached = false;
+        bool cached_accumulator = false;
+        Position cached_position;
+        Position chosen;
+        float chosen_value = 0.0f;
+        /*
+            update is TD(lambda) with step size alpha, the eligibility traces
+            run over a game and are cleared by new_game. Lambda 0 is TD(0) and keeps no traces
+        */
+        float alpha = 0.1f;
+        float lambda = 0.3f;
+        std::vector<std::vector<float>> traces; // of the parameters of nn, for REVGRAD
+        std::vector<float> errors; // of the batch of update, divided by its size
+        Model(int hidden_units, uint64_t seed = 0, Backend backend = Backend::REVGRAD);
         void save(std::string filename);
         void load(std::string filename);
-        RevGrad::Tensor tensor_from_state(const State& state);
-        int choose_move(const State& state, const Dice& dice, const Moves& moves);
+        void encode(const Position& position, float* x, int stride);
+        void encode(const Position& position, SparseInput& x);
+        RevGrad::Tensor tensor_from_state(const Position& position);
+        RevGrad::Tensor tensor_from_afterstates(const AfterstateList& afterstates);
+        /*
+            @return the value of every afterstate on backend, valid until the next call
+        */
+        const float* evaluate(const Position& position, const AfterstateList& afterstates, Backend backend);
+        int choose_move(const Position& position, const Dice& dice, const AfterstateList& afterstates);
+        /*
+            @return the positions of games the fp32 network plays against itself with seeded dice
+        */
+        std::vector<Position> sample_positions(int games, uint64_t seed);
+        /*
+            Makes quantized_network from the current weights,
+            calibrating the hidden activations on positions
+        */
+        void quantize(const std::vector<Position>& positions);
+        /*
+            @return quantized_network, made on first use from the weights at that time
+            by calibrating on the positions of CALIBRATION_GAMES games of seed
+        */
+        QuantizedNetwork& quantized();
+        /*
+            @return true if the game is over at next, then reward is 1 if white won and 0 otherwise
+        */
+        static bool game_over(const Position& next, float& reward);
         void new_game();
-        RevGrad::Tensor predict(const State& state);
-        void update(const State& state, const Move& move);
+        RevGrad::Tensor predict(const Position& position);
+        void update(const Position& position, const Position& next);
+        /*
+            @param x inputs x n encoded positions, one column per position
+            @param out their n values
+        */
+        void evaluate(const float* x, int n, float* out);
+        /*
+            One step of size step_size on the mean squared error of a batch, with one forward 
+            and one backward pass through nn whatever the backend, the ANALYTIC weights are synced around it
+            @param x inputs x n encoded positions, one column per position
+            @param targets the n values they should have
+        */
+        void update(const float* x, const float* targets, int n, float step_size);
     };
 }
 
@@ -0,0 +1,133 @@
+#include "QuantizedNetwork.h"
+#include "../RevGrad/kernel/Math.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace Backgammon {
+    QuantizedNetwork::QuantizedNetwork(const ValueNetwork& network, const std::vector<int>& continuous) 
+        : network(network),
+          inputs(network.inputs),
+          hidden(network.hidden),
+          stride((network.hidden + 31) / 32 * 32),
+          slots(network.inputs, -1),
+          w1(network.inputs * stride, 0),
+          b1(stride, 0),
+          wc(continuous.size() * stride, 0.0f),
+          w2(stride, 0),
+          b2(*network.b2),
+          a(stride, 0),
+          c(stride, 0.0f),
+          h(stride, 0)
+    {
+        for (int i = 0; i < (int)continuous.size(); i++) {
+            slots[continuous[i]] = i;
+        }
+    }
+
+    void QuantizedNetwork::observe(const SparseInput& x) {
+        // the fp32 pre-activations, split in the part of the accumulators and the continuous part
+        std::vector<float> accumulator(network.b1, network.b1 + hidden);
+        std::vector<float> sum(hidden, 0.0f);
+        for (int i = 0; i < x.size; i++) {
+            int k = x.indices[i];
+            const float* w = network.w1 + k * network.stride;
+            std::vector<float>& target = slots[k] == -1 ? accumulator : sum;
+            for (int j = 0; j < hidden; j++) {
+                target[j] += x.values[i] * w[j];
+            }
+        }
+        for (int j = 0; j < hidden; j++) {
+            max_accumulator = std::max(max_accumulator, std::fabs(accumulator[j]));
+            max_activation = std::max(max_activation, accumulator[j] + sum[j]);
+        }
+    }
+
+    /*
+        @return value rounded and clamped to the int16 range, counting the values clamped in saturated
+    */
+    static int16_t saturate(float value, int& saturated) {
+        long rounded = std::lround(value);
+        if (rounded > 32767 || rounded < -32767) {
+            saturated++;
+            return rounded > 0 ? 32767 : -32767;
+        }
+        return rounded;
+    }
+
+    void QuantizedNetwork::quantize() {
+        float max_w2 = 1e-6f;
+        for (int j = 0; j < hidden; j++) {
+            max_w2 = std::max(max_w2, std::fabs(network.w2[j]));
+        }
+        accumulator_scale = 32767.0f / (ACCUMULATOR_HEADROOM * std::max(max_accumulator, 1e-6f));
+        hidden_scale = 127.0f / std::max(max_activation, 1e-6f);
+        output_scale = 127.0f / max_w2;
+        saturated = 0;
+        for (int k = 0; k < inputs; k++) {
+            const float* w = network.w1 + k * network.stride;
+            for (int j = 0; j < hidden; j++) {
+                if (slots[k] == -1) {
+                    w1[k * stride + j] = saturate(w[j] * accumulator_scale / INPUT_SCALE, saturated);
+                } else {
+                    wc[slots[k] * stride + j] = w[j];
+                }
+            }
+        }
+        for (int j = 0; j < hidden; j++) {
+            b1[j] = saturate(network.b1[j] * accumulator_scale, saturated);
+            w2[j] = std::lround(network.w2[j] * output_scale);
+        }
+    }
+
+    float QuantizedNetwork::forward(const SparseInput& x) {
+        int16_t* acc = a.data();
+        float* sum = c.data();
+        std::copy(b1.begin(), b1.end(), acc);
+        std::fill(c.begin(), c.end(), 0.0f);
+        for (int i = 0; i < x.size; i++) {
+            int k = x.indices[i];
+            if (slots[k] != -1) {
+                const float* w = wc.data() + slots[k] * stride;
+                float value = x.values[i];
+                #pragma omp simd
+                for (int j = 0; j < stride; j++) {
+                    sum[j] += value * w[j];
+                }
+                continue;
+            }
+            const int16_t* w = w1.data() + k * stride;
+            int16_t value = (int16_t)(x.values[i] * INPUT_SCALE + 0.5f); // inputs are not negative
+            #pragma omp simd
+            for (int j = 0; j < stride; j++) {
+                acc[j] += value * w[j];
+            }
+        }
+        // dequantize, add the continuous part and requantize to int8
+        float dequantize = 1.0f / accumulator_scale;
+        int8_t* activations = h.data();
+        #pragma omp simd
+        for (int j = 0; j < stride; j++) {
+            float pre_activation = acc[j] * dequantize + sum[j];
+            int32_t value = (int32_t)(pre_activation * hidden_scale + 0.5f);
+            activations[j] = value < 0 ? 0 : (value > 127 ? 127 : value);
+        }
+        const int8_t* weights = w2.data();
+        int32_t z = 0;
+        #pragma omp simd reduction(+:z)
+        for (int j = 0; j < stride; j++) {
+            z += (int32_t)activations[j] * (int32_t)weights[j];
+        }
+        return RevGrad::Kernel::sigmoid(z / (hidden_scale * output_scale) + b2);
+    }
+
+    int QuantizedNetwork::bytes() const {
+        return (
+            w1.size() * sizeof(int16_t) + 
+            b1.size() * sizeof(int16_t) + 
+            wc.size() * sizeof(float) + 
+            w2.size() * sizeof(int8_t) + 
+            sizeof(float)
+        );
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef QUANTIZED_NETWORK_H
+#define QUANTIZED_NETWORK_H
+
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+#include "ValueNetwork.h"
+
+namespace Backgammon {
+    #define INPUT_SCALE 2 // most inputs are multiples of 1 / INPUT_SCALE
+    #define ACCUMULATOR_HEADROOM 2.0f
+
+    /*
+        Integer version of a ValueNetwork, for inference only.
+        The first layer has int16 weights and int16 accumulators, the hidden activations
+        and the second layer weights are int8.
+        Inputs that are not multiples of 1 / INPUT_SCALE (continuous ones) go through
+        fp32 weights instead and are added to the accumulators when they are dequantized.
+        The accumulators are scaled so the largest first layer pre-activation seen in calibration 
+        uses 1 / ACCUMULATOR_HEADROOM of their range, intermediate sums may wrap around.
+
+        Made in two steps: observe the fp32 network on a set of positions, then quantize
+    */
+    class QuantizedNetwork {
+    public:
+        const ValueNetwork& network;
+        int inputs;
+        int hidden;
+        int stride; // between the columns of w1
+        std::vector<int> slots; // column of each continuous input in wc, -1 for the others
+        std::vector<int16_t> w1; // inputs x hidden column major, times accumulator_scale / INPUT_SCALE
+        std::vector<int16_t> b1; // times accumulator_scale
+        std::vector<float> wc;   // continuous inputs x hidden column major
+        std::vector<int8_t> w2;  // times output_scale
+        float b2;
+        float accumulator_scale;
+        float hidden_scale; // hidden activations are stored times hidden_scale
+        float output_scale;
+        float max_accumulator = 0.0f;
+        float max_activation = 0.0f;
+        /*
+            First layer weights and biases that did not fit in int16 and were clamped, 
+            only possible for weights much larger than the pre-activations seen in calibration
+        */
+        int saturated = 0;
+        std::vector<int16_t> a; // first layer accumulators
+        std::vector<float> c;   // first layer sums of the continuous inputs
+        std::vector<int8_t> h;
+        /*
+            @param continuous the inputs that need fp32 weights
+        */
+        QuantizedNetwork(const ValueNetwork& network, const std::vector<int>& continuous);
+        /*
+            Calibration, keeps track of the ranges on x
+        */
+        void observe(const SparseInput& x);
+        void quantize();
+        float forward(const SparseInput& x);
+        /*
+            @return size of the weights in bytes
+        */
+        int bytes() const;
+    };
+}
+
+#endif
@@ -0,0 +1,438 @@
+#include "ValueNetwork.h"
+#include "Model.h"
+#include "../RevGrad/kernel/Gemm.h"
+#include "../RevGrad/kernel/Math.h"
+
+#include <cmath>
+#include <type_traits>
+
+namespace Backgammon {
+    ValueNetwork::ValueNetwork(int inputs, int hidden, int stride) 
+        : inputs(inputs),
+          hidden(hidden),
+          stride(stride),
+          eligibility(inputs * stride + 2 * stride + 1, 0.0f)
+    {}
+
+    std::unique_ptr<ValueNetwork> ValueNetwork::create(int inputs, int hidden) {
+        if (inputs == 201) {
+            switch (hidden) {
+                case 40: return std::make_unique<ValueNet<201, 40>>();
+                case 80: return std::make_unique<ValueNet<201, 80>>();
+                case 160: return std::make_unique<ValueNet<201, 160>>();
+            }
+        }
+        return std::make_unique<RuntimeValueNetwork>(inputs, hidden);
+    }
+
+    void ValueNetwork::read(const NeuralNetwork& nn) {
+        assert(nn.l1.weights.size() == hidden * inputs && nn.l2.weights.size() == hidden);
+        const float* weights = nn.l1.weights.values().data();
+        for (int j = 0; j < hidden; j++) {
+            for (int k = 0; k < inputs; k++) {
+                w1[k * stride + j] = weights[j * inputs + k];
+            }
+        }
+        std::copy(nn.l1.bias.values().begin(), nn.l1.bias.values().end(), b1);
+        std::copy(nn.l2.weights.values().begin(), nn.l2.weights.values().end(), w2);
+        *b2 = nn.l2.bias.values()[0];
+    }
+
+    void ValueNetwork::write(NeuralNetwork& nn) const {
+        assert(nn.l1.weights.size() == hidden * inputs && nn.l2.weights.size() == hidden);
+        float* weights = nn.l1.weights.values().data();
+        for (int j = 0; j < hidden; j++) {
+            for (int k = 0; k < inputs; k++) {
+                weights[j * inputs + k] = w1[k * stride + j];
+            }
+        }
+        std::copy(b1, b1 + hidden, nn.l1.bias.values().begin());
+        std::copy(w2, w2 + hidden, nn.l2.weights.values().begin());
+        nn.l2.bias.values()[0] = *b2;
+    }
+
+    static bool same_sizes(const ValueNetwork& a, const ValueNetwork& b) {
+        return a.inputs == b.inputs && a.hidden == b.hidden && a.stride == b.stride;
+    }
+
+    void ValueNetwork::share(ValueNetwork& network) {
+        assert(same_sizes(*this, network));
+        w1 = network.w1;
+        b1 = network.b1;
+        w2 = network.w2;
+        b2 = network.b2;
+    }
+
+    void ValueNetwork::copy(const ValueNetwork& network) {
+        assert(same_sizes(*this, network));
+        std::copy(network.w1, network.w1 + inputs * stride, w1);
+        std::copy(network.b1, network.b1 + hidden, b1);
+        std::copy(network.w2, network.w2 + hidden, w2);
+        *b2 = *network.b2;
+    }
+
+    void ValueNetwork::add_difference(const ValueNetwork& a, const ValueNetwork& b) {
+        assert(same_sizes(*this, a) && same_sizes(*this, b));
+        #pragma omp simd
+        for (int i = 0; i < inputs * stride; i++) {
+            w1[i] += a.w1[i] - b.w1[i];
+        }
+        for (int j = 0; j < hidden; j++) {
+            b1[j] += a.b1[j] - b.b1[j];
+            w2[j] += a.w2[j] - b.w2[j];
+        }
+        *b2 += *a.b2 - *b.b2;
+    }
+
+    float ValueNetwork::activate(const float* a) {
+        float z = *b2;
+        for (int j = 0; j < hidden; j++) {
+            h[j] = std::max(0.0f, a[j]);
+            z += w2[j] * h[j];
+        }
+        output = RevGrad::Kernel::sigmoid(z);
+        return output;
+    }
+
+    /*
+        Decays the traces and adds the gradient of the second layer and the first layer biases,
+        leaving in dh the gradient at the hidden pre-activations for the first layer weights
+        @return the traces of w1
+    */
+    static float* decay_trace(ValueNetwork& network, float lambda) {
+        int size = network.eligibility.size();
+        float* e = network.eligibility.data();
+        #pragma omp simd
+        for (int i = 0; i < size; i++) {
+            e[i] *= lambda;
+        }
+        float* e_b1 = e + network.inputs * network.stride;
+        float* e_w2 = e_b1 + network.stride;
+        float d = network.output * (1.0f - network.output);
+        for (int j = 0; j < network.hidden; j++) {
+            network.dh[j] = network.h[j] > 0.0f ? d * network.w2[j] : 0.0f;
+            e_b1[j] += network.dh[j];
+            e_w2[j] += d * network.h[j];
+        }
+        e_w2[network.stride] += d;
+        return e;
+    }
+
+    void ValueNetwork::trace(const float* x, float lambda) {
+        float* e = decay_trace(*this, lambda);
+        for (int k = 0; k < inputs; k++) {
+            float* e_k = e + k * stride;
+            float value = x[k];
+            #pragma omp simd
+            for (int j = 0; j < hidden; j++) {
+                e_k[j] += value * dh[j];
+            }
+        }
+    }
+
+    void ValueNetwork::trace(const SparseInput& x, float lambda) {
+        float* e = decay_trace(*this, lambda);
+        for (int i = 0; i < x.size; i++) {
+            float* e_k = e + x.indices[i] * stride;
+            float value = x.values[i];
+            #pragma omp simd
+            for (int j = 0; j < hidden; j++) {
+                e_k[j] += value * dh[j];
+            }
+        }
+    }
+
+    void ValueNetwork::step_trace(float delta) {
+        const float* e = eligibility.data();
+        const float* e_b1 = e + inputs * stride;
+        const float* e_w2 = e_b1 + stride;
+        #pragma omp simd
+        for (int i = 0; i < inputs * stride; i++) {
+            w1[i] += delta * e[i];
+        }
+        for (int j = 0; j < hidden; j++) {
+            b1[j] += delta * e_b1[j];
+            w2[j] += delta * e_w2[j];
+        }
+        *b2 += delta * e_w2[stride];
+    }
+
+    void ValueNetwork::reset_trace() {
+        std::fill(eligibility.begin(), eligibility.end(), 0.0f);
+    }
+
+    void ValueNetwork::evaluate(const float* x, int n, float* out) {
+        if ((int)batch.size() < hidden * n) {
+            batch.resize(hidden * n);
+        }
+        float* a = batch.data();
+        for (int j = 0; j < hidden; j++) {
+            std::fill(a + j * n, a + (j + 1) * n, b1[j]);
+        }
+        RevGrad::Kernel::gemm(
+            true, false, hidden, n, inputs,
+            1.0f, w1, stride,
+            x, n,
+            1.0f, a, n
+        );
+        std::fill(out, out + n, *b2);
+        for (int j = 0; j < hidden; j++) {
+            const float* row = a + j * n;
+            float w = w2[j];
+            #pragma omp simd
+            for (int c = 0; c < n; c++) {
+                out[c] += w * std::max(0.0f, row[c]);
+            }
+        }
+        RevGrad::Kernel::sigmoid(out, out, n);
+    }
+
+    /*
+        The single position kernels, shared by both subclasses. The sizes are ints,
+        or std::integral_constant for ValueNet so the loops get constant bounds.
+        Input k adds x[k] times column k of w1 to the hidden pre-activations,
+        the sparse kernels do it only for the non-zero entries
+    */
+    template <class Hidden>
+    static float output_kernel(Hidden hidden, const float* w2, float b2, float* h) {
+        float z = b2;
+        #pragma omp simd reduction(+:z)
+        for (int j = 0; j < hidden; j++) {
+            h[j] = std::max(0.0f, h[j]);
+            z += w2[j] * h[j];
+        }
+        return RevGrad::Kernel::sigmoid(z);
+    }
+
+    template <class Hidden>
+    static float value_kernel(Hidden hidden, const float* w2, float b2, const float* a) {
+        float z = b2;
+        #pragma omp simd reduction(+:z)
+        for (int j = 0; j < hidden; j++) {
+            z += w2[j] * std::max(0.0f, a[j]);
+        }
+        return RevGrad::Kernel::sigmoid(z);
+    }
+
+    template <class Hidden, class Stride>
+    static void add_kernel(Hidden hidden, Stride stride, const float* w1, const SparseInput& x, float* a) {
+        for (int i = 0; i < x.size; i++) {
+            const float* w = w1 + x.indices[i] * stride;
+            float value = x.values[i];
+            #pragma omp simd
+            for (int j = 0; j < hidden; j++) {
+                a[j] += value * w[j];
+            }
+        }
+    }
+
+    template <class Inputs, class Hidden, class Stride>
+    static float forward_kernel(
+        Inputs inputs, Hidden hidden, Stride stride,
+        const float* w1, const float* b1, const float* w2, float b2, 
+        const float* x, float* h
+    ) {
+        std::copy(b1, b1 + hidden, h);
+        for (int k = 0; k < inputs; k++) {
+            const float* w = w1 + k * stride;
+            float value = x[k];
+            #pragma omp simd
+            for (int j = 0; j < hidden; j++) {
+                h[j] += value * w[j];
+            }
+        }
+        return output_kernel(hidden, w2, b2, h);
+    }
+
+    template <class Hidden, class Stride>
+    static float forward_kernel(
+        Hidden hidden, Stride stride,
+        const float* w1, const float* b1, const float* w2, float b2, 
+        const SparseInput& x, float* h
+    ) {
+        std::copy(b1, b1 + hidden, h);
+        add_kernel(hidden, stride, w1, x, h);
+        return output_kernel(hidden, w2, b2, h);
+    }
+
+    /*
+        Steps the second layer and the first layer biases, leaving in dh the gradient 
+        at the hidden pre-activations the first layer weights are stepped with
+    */
+    template <class Hidden>
+    static void output_step_kernel(
+        Hidden hidden, float* b1, float* w2, float& b2, 
+        const float* h, float* dh, float output, float delta
+    ) {
+        // gradient at the pre-activation of the output
+        float d = delta * output * (1.0f - output);
+        #pragma omp simd
+        for (int j = 0; j < hidden; j++) {
+            // through the old w2, and only where the ReLU was active
+            dh[j] = h[j] > 0.0f ? d * w2[j] : 0.0f;
+            w2[j] += d * h[j];
+            b1[j] += dh[j];
+        }
+        b2 += d;
+    }
+
+    template <class Inputs, class Hidden, class Stride>
+    static void step_kernel(
+        Inputs inputs, Hidden hidden, Stride stride,
+        float* w1, float* b1, float* w2, float& b2, 
+        const float* x, const float* h, float* dh, float output, float delta
+    ) {
+        output_step_kernel(hidden, b1, w2, b2, h, dh, output, delta);
+        for (int k = 0; k < inputs; k++) {
+            float* w = w1 + k * stride;
+            float value = x[k];
+            #pragma omp simd
+            for (int j = 0; j < hidden; j++) {
+                w[j] += value * dh[j];
+            }
+        }
+    }
+
+    template <class Hidden, class Stride>
+    static void step_kernel(
+        Hidden hidden, Stride stride,
+        float* w1, float* b1, float* w2, float& b2, 
+        const SparseInput& x, const float* h, float* dh, float output, float delta
+    ) {
+        output_step_kernel(hidden, b1, w2, b2, h, dh, output, delta);
+        for (int i = 0; i < x.size; i++) {
+            float* w = w1 + x.indices[i] * stride;
+            float value = x.values[i];
+            #pragma omp simd
+            for (int j = 0; j < hidden; j++) {
+                w[j] += value * dh[j];
+            }
+        }
+    }
+
+    RuntimeValueNetwork::RuntimeValueNetwork(int inputs, int hidden) 
+        : ValueNetwork(inputs, hidden, hidden),
+          w1_values(inputs * hidden),
+          b1_values(hidden),
+          w2_values(hidden),
+          h_values(hidden),
+          dh_values(hidden)
+    {
+        w1 = w1_values.data();
+        b1 = b1_values.data();
+        w2 = w2_values.data();
+        b2 = &b2_value;
+        h = h_values.data();
+        dh = dh_values.data();
+    }
+
+    float RuntimeValueNetwork::forward(const float* x) {
+        output = forward_kernel(inputs, hidden, stride, w1, b1, w2, *b2, x, h);
+        return output;
+    }
+
+    float RuntimeValueNetwork::forward(const SparseInput& x) {
+        output = forward_kernel(hidden, stride, w1, b1, w2, *b2, x, h);
+        return output;
+    }
+
+    void RuntimeValueNetwork::step(const float* x, float delta) {
+        step_kernel(inputs, hidden, stride, w1, b1, w2, *b2, x, h, dh, output, delta);
+    }
+
+    void RuntimeValueNetwork::step(const SparseInput& x, float delta) {
+        step_kernel(hidden, stride, w1, b1, w2, *b2, x, h, dh, output, delta);
+    }
+
+    void RuntimeValueNetwork::accumulate(const SparseInput& x, float* a) {
+        std::copy(b1, b1 + hidden, a);
+        add_kernel(hidden, stride, w1, x, a);
+    }
+
+    void RuntimeValueNetwork::add(const SparseInput& delta, float* a) {
+        add_kernel(hidden, stride, w1, delta, a);
+    }
+
+    float RuntimeValueNetwork::value(const float* a) {
+        return value_kernel(hidden, w2, *b2, a);
+    }
+
+    template <int INPUTS, int HIDDEN>
+    ValueNet<INPUTS, HIDDEN>::ValueNet() : ValueNetwork(INPUTS, HIDDEN, STRIDE) {
+        w1_values.fill(0.0f);
+        b1_values.fill(0.0f);
+        w2_values.fill(0.0f);
+        h_values.fill(0.0f);
+        dh_values.fill(0.0f);
+        w1 = w1_values.data();
+        b1 = b1_values.data();
+        w2 = w2_values.data();
+        b2 = &b2_value;
+        h = h_values.data();
+        dh = dh_values.data();
+    }
+
+    template <int INPUTS, int HIDDEN>
+    float ValueNet<INPUTS, HIDDEN>::forward(const float* x) {
+        output = forward_kernel(
+            std::integral_constant<int, INPUTS>(), 
+            std::integral_constant<int, HIDDEN>(), 
+            std::integral_constant<int, STRIDE>(), 
+            w1, b1, w2, *b2, x, h
+        );
+        return output;
+    }
+
+    template <int INPUTS, int HIDDEN>
+    float ValueNet<INPUTS, HIDDEN>::forward(const SparseInput& x) {
+        output = forward_kernel(
+            std::integral_constant<int, HIDDEN>(), 
+            std::integral_constant<int, STRIDE>(), 
+            w1, b1, w2, *b2, x, h
+        );
+        return output;
+    }
+
+    template <int INPUTS, int HIDDEN>
+    void ValueNet<INPUTS, HIDDEN>::step(const float* x, float delta) {
+        step_kernel(
+            std::integral_constant<int, INPUTS>(), 
+            std::integral_constant<int, HIDDEN>(), 
+            std::integral_constant<int, STRIDE>(), 
+            w1, b1, w2, *b2, x, h, dh, output, delta
+        );
+    }
+
+    template <int INPUTS, int HIDDEN>
+    void ValueNet<INPUTS, HIDDEN>::step(const SparseInput& x, float delta) {
+        step_kernel(
+            std::integral_constant<int, HIDDEN>(), 
+            std::integral_constant<int, STRIDE>(), 
+            w1, b1, w2, *b2, x, h, dh, output, delta
+        );
+    }
+
+    template <int INPUTS, int HIDDEN>
+    void ValueNet<INPUTS, HIDDEN>::accumulate(const SparseInput& x, float* a) {
+        std::copy(b1, b1 + HIDDEN, a);
+        add(x, a);
+    }
+
+    template <int INPUTS, int HIDDEN>
+    void ValueNet<INPUTS, HIDDEN>::add(const SparseInput& delta, float* a) {
+        add_kernel(
+            std::integral_constant<int, HIDDEN>(), 
+            std::integral_constant<int, STRIDE>(), 
+            w1, delta, a
+        );
+    }
+
+    template <int INPUTS, int HIDDEN>
+    float ValueNet<INPUTS, HIDDEN>::value(const float* a) {
+        return value_kernel(std::integral_constant<int, HIDDEN>(), w2, *b2, a);
+    }
+
+    template class ValueNet<201, 40>;
+    template class ValueNet<201, 80>;
+    template class ValueNet<201, 160>;
+}
@@ -0,0 +1,174 @@
+#ifndef VALUE_NETWORK_H
+#define VALUE_NETWORK_H
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <cassert>
+
+namespace Backgammon {
+    #define MAX_SPARSE_INPUTS 256
+
+    class NeuralNetwork;
+
+    /*
+        The non-zero entries of an input vector
+    */
+    class SparseInput {
+    public:
+        std::array<int, MAX_SPARSE_INPUTS> indices;
+        std::array<float, MAX_SPARSE_INPUTS> values;
+        int size = 0;
+        void clear() { size = 0; }
+        void push(int index, float value) {
+            assert(size < MAX_SPARSE_INPUTS);
+            indices[size] = index;
+            values[size] = value;
+            size++;
+        }
+    };
+
+    /*
+        The inputs -> hidden -> 1 ReLU/sigmoid network of NeuralNetwork, with the forward pass
+        and the gradient of the output written out by hand. Works in buffers allocated once,
+        the weights are a copy of the RevGrad parameters kept in sync with read and write.
+        The buffers belong to the subclass, which points w1, b1, w2, b2, h and dh at them,
+        share points the weights at the buffers of another network instead.
+        w1 is stored column major, so the weights of one input are contiguous and
+        a sparse input only touches the columns of its non-zero entries
+    */
+    class ValueNetwork {
+    public:
+        int inputs;
+        int hidden;
+        int stride; // between the columns of w1
+        float* w1;  // inputs x hidden, the transpose of the RevGrad weights
+        float* b1;
+        float* w2;
+        float* b2;
+        float* h;   // hidden activations of the last forward
+        float* dh;  // gradient at the hidden pre-activations in step
+        float output = 0.0f; // output of the last forward
+        std::vector<float> batch; // hidden x n activations of evaluate
+        /*
+            Eligibility traces of w1, b1, w2 and b2 in that order, w1 and b1 with the layout of the weights.
+            They belong to this network even when the weights are shared
+        */
+        std::vector<float> eligibility;
+        ValueNetwork(int inputs, int hidden, int stride);
+        virtual ~ValueNetwork() {}
+        ValueNetwork(const ValueNetwork&) = delete;
+        ValueNetwork& operator=(const ValueNetwork&) = delete;
+        /*
+            @return a ValueNet compiled for these sizes if there is one, 
+            otherwise a RuntimeValueNetwork
+        */
+        static std::unique_ptr<ValueNetwork> create(int inputs, int hidden);
+        void read(const NeuralNetwork& nn);
+        void write(NeuralNetwork& nn) const;
+        /*
+            Uses the weights of network, which has the same sizes, from now on.
+            Both step the same weights, concurrent steps are not synchronized
+        */
+        void share(ValueNetwork& network);
+        /*
+            Sets the weights to those of network
+        */
+        void copy(const ValueNetwork& network);
+        /*
+            weights += a - b, the networks have the same sizes
+        */
+        void add_difference(const ValueNetwork& a, const ValueNetwork& b);
+        /*
+            @param x inputs features
+            @return the value, the activations are kept for step
+        */
+        virtual float forward(const float* x) = 0;
+        virtual float forward(const SparseInput& x) = 0;
+        /*
+            @param x inputs x n features, one column per position
+            @param out the n values
+        */
+        void evaluate(const float* x, int n, float* out);
+        /*
+            parameters += delta * gradient of the output of the last forward,
+            @param x the features given to that forward
+        */
+        virtual void step(const float* x, float delta) = 0;
+        virtual void step(const SparseInput& x, float delta) = 0;
+        /*
+            eligibility = lambda * eligibility + gradient of the output of the last forward,
+            @param x the features given to that forward
+        */
+        void trace(const float* x, float lambda);
+        void trace(const SparseInput& x, float lambda);
+        /*
+            parameters += delta * eligibility
+        */
+        void step_trace(float delta);
+        void reset_trace();
+        /*
+            Accumulator of the first layer: a holds the hidden pre-activations b1 + w1 * x
+            of some input x and is moved to another input by adding w1 times their difference
+        */
+        virtual void accumulate(const SparseInput& x, float* a) = 0;
+        virtual void add(const SparseInput& delta, float* a) = 0;
+        /*
+            @return the value of the input with hidden pre-activations a
+        */
+        virtual float value(const float* a) = 0;
+        /*
+            Forward from the hidden pre-activations a, the activations are kept for step
+            @return the value
+        */
+        float activate(const float* a);
+    };
+
+    /*
+        Sizes known only at run time
+    */
+    class RuntimeValueNetwork : public ValueNetwork {
+        std::vector<float> w1_values;
+        std::vector<float> b1_values;
+        std::vector<float> w2_values;
+        float b2_value = 0.0f;
+        std::vector<float> h_values;
+        std::vector<float> dh_values;
+    public:
+        RuntimeValueNetwork(int inputs, int hidden);
+        float forward(const float* x) override;
+        float forward(const SparseInput& x) override;
+        void step(const float* x, float delta) override;
+        void step(const SparseInput& x, float delta) override;
+        void accumulate(const SparseInput& x, float* a) override;
+        void add(const SparseInput& delta, float* a) override;
+        float value(const float* a) override;
+    };
+
+    /*
+        Sizes known at compile time, so the loops have constant bounds. 
+        The columns of w1 are padded to a multiple of 16 floats to keep each one 64 byte aligned.
+        Instantiated in ValueNetwork.cpp for the sizes create picks from
+    */
+    template <int INPUTS, int HIDDEN>
+    class ValueNet : public ValueNetwork {
+        static constexpr int STRIDE = (HIDDEN + 15) / 16 * 16;
+        alignas(64) std::array<float, INPUTS * STRIDE> w1_values;
+        alignas(64) std::array<float, STRIDE> b1_values;
+        alignas(64) std::array<float, STRIDE> w2_values;
+        float b2_value = 0.0f;
+        alignas(64) std::array<float, STRIDE> h_values;
+        alignas(64) std::array<float, STRIDE> dh_values;
+    public:
+        ValueNet();
+        float forward(const float* x) override;
+        float forward(const SparseInput& x) override;
+        void step(const float* x, float delta) override;
+        void step(const SparseInput& x, float delta) override;
+        void accumulate(const SparseInput& x, float* a) override;
+        void add(const SparseInput& delta, float* a) override;
+        float value(const float* a) override;
+    };
+}
+
+#endif
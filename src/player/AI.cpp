@@ -3,15 +3,15 @@
 namespace Backgammon {
     AI::AI(std::string name, std::shared_ptr<Model> model) : name(name), model(model) {}
     
-    int AI::choose_move(const State& state, const Dice& dice, const Moves& moves) {
-        int index = model->choose_move(state, dice, moves);
-        assert(index < (int)moves.size());
+    int AI::choose_move(const Position& position, const Dice& dice, const AfterstateList& afterstates) {
+        int index = model->choose_move(position, dice, afterstates);
+        assert(index < afterstates.size);
         return index;
     }
 
     void AI::new_game() {}
 
-    void AI::no_moves(const State& state) {}
+    void AI::no_moves(const Position& position) {}
     
-    void AI::game_over(const State& state, int player) {}
+    void AI::game_over(const Position& position, int player) {}
 }
@@ -3,12 +3,12 @@
 namespace Backgammon {
     Human::Human(std::string name) : name(name) {}
     
-    int Human::choose_move(const State& state, const Dice& dice, const Moves& moves) {
-        if ((int)moves.size() <= 7) {
+    int Human::choose_move(const Position& position, const Dice& dice, const AfterstateList& afterstates) {
+        if (afterstates.size <= 7) {
             std::cout << "Choose a move:" << std::endl;
-            for (int i = 0; i < (int)moves.size(); i++) {
+            for (int i = 0; i < afterstates.size; i++) {
                 std::cout << "[" << i + 1 << "]: ";
-                for (auto [from, to] : moves[i]) {
+                for (auto [from, to] : afterstates[i].move.to_move()) {
                     std::cout << "(" << from + 1 << ", " << to + 1 << ") ";
                 }
                 std::cout << std::endl;
@@ -28,13 +28,13 @@ namespace Backgammon {
                     std::cout << s << " is not a number" << std::endl;
                 }
                 index = stoi(s);
-                if (index <= 0 && index > (int)moves.size()) {
-                    std::cout << index << " is not between 1 and " << (int)moves.size() << std::endl;
+                if (index <= 0 && index > afterstates.size) {
+                    std::cout << index << " is not between 1 and " << afterstates.size << std::endl;
                     index = -1;
                 }
             }
             index--;
-            assert(0 <= index && index < (int)moves.size());
+            assert(0 <= index && index < afterstates.size);
             return index;
         }
         int index = -1;
@@ -117,11 +117,18 @@ namespace Backgammon {
                 move.push_back(CheckerMove(from, to));
                 std::sort(move.begin(), move.end());
             } else if (action == 1) {
-                for (int i = 0; i < (int)moves.size(); i++) {
-                    if (moves[i] == move) {
-                        index = i;
+                // any order of checker moves reaching one of the afterstates is accepted
+                Position next = position;
+                bool legal = (int)move.size() <= MAX_CHECKER_MOVES;
+                for (auto [from, to] : move) {
+                    if (!legal || from < 0 || from > OUT || to < 0 || to > OUT || next.on[position.turn][from] <= 0) {
+                        legal = false;
                         break;
                     }
+                    next.make_checker_move(from, to);
+                }
+                if (legal) {
+                    index = afterstates.find(next.hash());
                 }
                 if (index == -1) {
                     std::cout << "Illegal move" << std::endl;
@@ -131,19 +138,19 @@ namespace Backgammon {
                 move.clear();
             }
         }
-        assert(0 <= index && index < (int)moves.size());
+        assert(0 <= index && index < afterstates.size);
         return index;
     }
 
     void Human::new_game() {}
 
-    void Human::no_moves(const State& state) {
+    void Human::no_moves(const Position& position) {
         std::cout << "No moves" << std::endl;
         std::cout << std::endl;
     }
 
-    void Human::game_over(const State& state, int player) {
-        Outcome outcome = state.outcome(player);
+    void Human::game_over(const Position& position, int player) {
+        Outcome outcome = position.outcome(player);
         std::string s;
         if (outcome == Outcome::WON_SINGLE_GAME) {
             s = " won a single game";
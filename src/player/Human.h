@@ -8,10 +8,10 @@ namespace Backgammon {
     public:
         std::string name;
         Human(std::string name);
-        int choose_move(const State& state, const Dice& dice, const Moves& moves);
+        int choose_move(const Position& position, const Dice& dice, const AfterstateList& afterstates);
         void new_game();
-        void no_moves(const State& state);
-        void game_over(const State& state, int player);
+        void no_moves(const Position& position);
+        void game_over(const Position& position, int player);
     };
 }
 
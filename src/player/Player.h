@@ -5,18 +5,19 @@
 
 namespace Backgammon {
     class CheckerMove;
-    class State;
+    class Position;
     class Dice;
+    class AfterstateList;
 
     typedef std::vector<CheckerMove> Move;
     typedef std::vector<Move> Moves;
 
     class Player {
     public:
-        virtual int choose_move(const State& state, const Dice& dice, const Moves& moves) { assert(false); }
+        virtual int choose_move(const Position& position, const Dice& dice, const AfterstateList& afterstates) { assert(false); }
         virtual void new_game() { assert(false); }
-        virtual void no_moves(const State& state) { assert(false); }
-        virtual void game_over(const State& state, int player) { assert(false); }
+        virtual void no_moves(const Position& position) { assert(false); }
+        virtual void game_over(const Position& position, int player) { assert(false); }
     };
 }
 
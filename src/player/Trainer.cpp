@@ -3,10 +3,10 @@
 namespace Backgammon {
     Trainer::Trainer(std::string name, std::shared_ptr<Model> model) : name(name), model(model) {}
 
-    int Trainer::choose_move(const State& state, const Dice& dice, const Moves& moves) {
-        int index = model->choose_move(state, dice, moves);
-        assert(index < (int)moves.size());
-        model->update(state, moves[index]);
+    int Trainer::choose_move(const Position& position, const Dice& dice, const AfterstateList& afterstates) {
+        int index = model->choose_move(position, dice, afterstates);
+        assert(index < afterstates.size);
+        model->update(position, afterstates[index].position);
         return index;
     }
 
@@ -14,7 +14,7 @@ namespace Backgammon {
         model->new_game();
     }
 
-    void Trainer::no_moves(const State& state) {}
+    void Trainer::no_moves(const Position& position) {}
     
-    void Trainer::game_over(const State& state, int player) {}
+    void Trainer::game_over(const Position& position, int player) {}
 }
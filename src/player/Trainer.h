@@ -10,10 +10,10 @@ namespace Backgammon {
         std::string name;
         std::shared_ptr<Model> model;
         Trainer(std::string name, std::shared_ptr<Model> model);
-        int choose_move(const State& state, const Dice& dice, const Moves& moves);
+        int choose_move(const Position& position, const Dice& dice, const AfterstateList& afterstates);
         void new_game();
-        void no_moves(const State& state);
-        void game_over(const State& state, int player);
+        void no_moves(const Position& position);
+        void game_over(const Position& position, int player);
     };
 }
 
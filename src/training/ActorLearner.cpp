@@ -0,0 +1,129 @@
+#include "ActorLearner.h"
+#include "../RevGrad/kernel/Gemm.h"
+
+#include <thread>
+
+namespace Backgammon {
+    Actor::Actor(std::string name, std::shared_ptr<Model> model, TransitionQueue& queue) 
+        : name(name), model(model), queue(queue) {}
+
+    int Actor::choose_move(const Position& position, const Dice& dice, const AfterstateList& afterstates) {
+        int index = model->choose_move(position, dice, afterstates);
+        assert(index < afterstates.size);
+        Transition transition = {position, afterstates[index].position};
+        while (!queue.try_push(transition)) {
+            std::this_thread::yield();
+        }
+        return index;
+    }
+
+    void Actor::new_game() {}
+
+    void Actor::no_moves(const Position& position) {}
+    
+    void Actor::game_over(const Position& position, int player) {}
+
+    ActorLearner::ActorLearner(
+        std::shared_ptr<Model> model, 
+        int actors, 
+        uint64_t dice_seed, 
+        int batch_size, 
+        int publish_frequency
+    ) 
+        : model(model),
+          actors(actors),
+          batch_size(batch_size),
+          publish_frequency(publish_frequency),
+          dice_seed(dice_seed),
+          queue(TRANSITION_QUEUE_SIZE)
+    {
+        assert(model->backend == Backend::ANALYTIC);
+        assert(actors > 0 && batch_size > 0 && publish_frequency > 0);
+        for (int i = 0; i < actors; i++) {
+            std::shared_ptr<Model> actor = std::make_shared<Model>(model->value_network->hidden, 0, Backend::ANALYTIC);
+            actor->sparse = model->sparse;
+            actor->incremental = model->incremental;
+            models.push_back(actor);
+            games.push_back(std::make_unique<Game>(
+                std::make_shared<Actor>("WHITE", actor, queue), 
+                std::make_shared<Actor>("BLACK", actor, queue),
+                dice_seed
+            ));
+        }
+    }
+
+    void ActorLearner::publish() {
+        ValueNetwork& weights = *model->value_network;
+        std::shared_ptr<ValueNetwork> copy = ValueNetwork::create(weights.inputs, weights.hidden);
+        copy->copy(weights);
+        std::atomic_store(&snapshot, copy);
+    }
+
+    long long ActorLearner::train(int first, int last) {
+        next_game = first;
+        playing = actors;
+        moves = 0;
+        publish();
+        // one game per thread already, so the kernels stay single threaded
+        int kernel_threads = RevGrad::Kernel::threads;
+        RevGrad::Kernel::threads = 1;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < actors; i++) {
+            threads.emplace_back(&ActorLearner::act, this, i, last);
+        }
+        // the moves of different games are interleaved in the queue, a trace would mix them
+        float lambda = model->lambda;
+        model->lambda = 0.0f;
+        learn();
+        model->lambda = lambda;
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        RevGrad::Kernel::threads = kernel_threads;
+        return moves;
+    }
+
+    void ActorLearner::act(int actor, int last) {
+        Game& game = *games[actor];
+        ValueNetwork& network = *models[actor]->value_network;
+        std::shared_ptr<ValueNetwork> weights;
+        for (int i = next_game++; i < last; i = next_game++) {
+            // a new snapshot is taken between games, the one in use stays alive through weights
+            std::shared_ptr<ValueNetwork> latest = std::atomic_load(&snapshot);
+            if (latest != weights) {
+                weights = latest;
+                network.share(*weights);
+            }
+            game.games_played = i;
+            game.play();
+            moves += game.history.size();
+        }
+        playing--;
+    }
+
+    void ActorLearner::learn() {
+        std::vector<Transition> batch(batch_size);
+        int updates = 0;
+        while (true) {
+            // read playing first, so an empty queue after it means every move is learned
+            bool done = playing == 0;
+            int size = 0;
+            while (size < batch_size && queue.try_pop(batch[size])) {
+                size++;
+            }
+            if (size == 0) {
+                if (done) {
+                    break;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            for (int i = 0; i < size; i++) {
+                model->update(batch[i].position, batch[i].next);
+                if (++updates % publish_frequency == 0) {
+                    publish();
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef ACTOR_LEARNER_H
+#define ACTOR_LEARNER_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include "../game/Game.h"
+#include "../model/Model.h"
+#include "BoundedQueue.h"
+
+namespace Backgammon {
+    #define TRANSITION_QUEUE_SIZE 16384
+
+    /*
+        A move of self-play, the outcome of a finished game can be read from next
+    */
+    class Transition {
+    public:
+        Position position;
+        Position next;
+    };
+
+    typedef BoundedQueue<Transition> TransitionQueue;
+
+    /*
+        Plays with a model that is only read, and pushes every move it makes to queue,
+        waiting while the queue is full
+    */
+    class Actor : public Player {
+    public:
+        std::string name;
+        std::shared_ptr<Model> model;
+        TransitionQueue& queue;
+        Actor(std::string name, std::shared_ptr<Model> model, TransitionQueue& queue);
+        int choose_move(const Position& position, const Dice& dice, const AfterstateList& afterstates);
+        void new_game();
+        void no_moves(const Position& position);
+        void game_over(const Position& position, int player);
+    };
+
+    /*
+        Trains one ANALYTIC model with actor threads that only play, and a learner thread 
+        that only updates. The actors play with a snapshot of the weights,
+        the learner takes the moves from the queue batch_size at a time 
+        and publishes a new snapshot every publish_frequency updates.
+        The learner does TD(0) whatever the lambda of model, the moves reach it from several games at once.
+        Game i is played with dice stream i of dice_seed whatever actor plays it
+    */
+    class ActorLearner {
+    public:
+        std::shared_ptr<Model> model; // the one the learner updates
+        int actors;
+        int batch_size;
+        int publish_frequency;
+        uint64_t dice_seed;
+        TransitionQueue queue;
+        std::shared_ptr<ValueNetwork> snapshot; // read and written with std::atomic_load and std::atomic_store
+        std::vector<std::shared_ptr<Model>> models;
+        std::vector<std::unique_ptr<Game>> games;
+        std::atomic<int> next_game;
+        std::atomic<int> playing; // actors not done yet
+        std::atomic<long long> moves;
+        ActorLearner(
+            std::shared_ptr<Model> model, 
+            int actors, 
+            uint64_t dice_seed, 
+            int batch_size = 64, 
+            int publish_frequency = 1024
+        );
+        /*
+            Plays games first to last - 1 and returns when every move of them is learned
+            @return number of moves made in them
+        */
+        long long train(int first, int last);
+        void act(int actor, int last);
+        void learn();
+        void publish();
+    };
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cassert>
+
+namespace Backgammon {
+    /*
+        Fixed capacity lock-free queue for any number of producers and consumers.
+        Every cell has a sequence number telling whether it is free for the push of
+        round position / capacity or holds the value for the pop of that round,
+        so push and pop each claim a position with one compare and swap.
+        The capacity is a power of 2
+    */
+    template <class T>
+    class BoundedQueue {
+        class Cell {
+        public:
+            std::atomic<uint64_t> sequence;
+            T value;
+        };
+        std::vector<Cell> cells;
+        uint64_t mask;
+        alignas(64) std::atomic<uint64_t> head; // next position to pop
+        alignas(64) std::atomic<uint64_t> tail; // next position to push
+    public:
+        BoundedQueue(int capacity) : cells(capacity), mask(capacity - 1), head(0), tail(0) {
+            assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+            for (int i = 0; i < capacity; i++) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        /*
+            @return false if the queue is full
+        */
+        bool try_push(const T& value) {
+            uint64_t position = tail.load(std::memory_order_relaxed);
+            while (true) {
+                Cell& cell = cells[position & mask];
+                uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+                int64_t difference = (int64_t)sequence - (int64_t)position;
+                if (difference == 0) {
+                    if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        cell.value = value;
+                        cell.sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (difference < 0) {
+                    return false;
+                } else {
+                    position = tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        /*
+            @return false if the queue is empty
+        */
+        bool try_pop(T& value) {
+            uint64_t position = head.load(std::memory_order_relaxed);
+            while (true) {
+                Cell& cell = cells[position & mask];
+                uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+                int64_t difference = (int64_t)sequence - (int64_t)(position + 1);
+                if (difference == 0) {
+                    if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        value = cell.value;
+                        cell.sequence.store(position + mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (difference < 0) {
+                    return false;
+                } else {
+                    position = head.load(std::memory_order_relaxed);
+                }
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include "ParallelTrainer.h"
+#include "../player/Trainer.h"
+#include "../RevGrad/kernel/Gemm.h"
+
+#include <thread>
+
+namespace Backgammon {
+    ParallelTrainer::ParallelTrainer(
+        std::shared_ptr<Model> model, 
+        int threads, 
+        uint64_t dice_seed, 
+        Sharing sharing, 
+        int merge_frequency
+    ) 
+        : model(model),
+          threads(threads),
+          sharing(sharing),
+          merge_frequency(merge_frequency),
+          dice_seed(dice_seed)
+    {
+        assert(model->backend == Backend::ANALYTIC);
+        assert(threads > 0 && merge_frequency > 0);
+        ValueNetwork& shared = *model->value_network;
+        for (int i = 0; i < threads; i++) {
+            std::shared_ptr<Model> worker = std::make_shared<Model>(shared.hidden, 0, Backend::ANALYTIC);
+            worker->sparse = model->sparse;
+            worker->incremental = model->incremental;
+            worker->alpha = model->alpha;
+            worker->lambda = model->lambda;
+            if (sharing == Sharing::HOGWILD) {
+                worker->value_network->share(shared);
+            } else {
+                bases.push_back(ValueNetwork::create(shared.inputs, shared.hidden));
+            }
+            models.push_back(worker);
+            games.push_back(std::make_unique<Game>(
+                std::make_shared<Trainer>("WHITE", worker), 
+                std::make_shared<Trainer>("BLACK", worker),
+                dice_seed
+            ));
+        }
+    }
+
+    long long ParallelTrainer::train(int first, int last) {
+        next_game = first;
+        moves = 0;
+        if (sharing == Sharing::BUFFERED) {
+            for (int i = 0; i < threads; i++) {
+                models[i]->value_network->copy(*model->value_network);
+                bases[i]->copy(*model->value_network);
+            }
+        }
+        // one game per thread already, so the kernels stay single threaded
+        int kernel_threads = RevGrad::Kernel::threads;
+        RevGrad::Kernel::threads = 1;
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; i++) {
+            workers.emplace_back(&ParallelTrainer::work, this, i, last);
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        RevGrad::Kernel::threads = kernel_threads;
+        return moves;
+    }
+
+    void ParallelTrainer::work(int worker, int last) {
+        Game& game = *games[worker];
+        int played = 0;
+        for (int i = next_game++; i < last; i = next_game++) {
+            game.games_played = i;
+            game.play();
+            moves += game.history.size();
+            played++;
+            if (sharing == Sharing::BUFFERED && played % merge_frequency == 0) {
+                merge(worker);
+            }
+        }
+        if (sharing == Sharing::BUFFERED) {
+            merge(worker);
+        }
+    }
+
+    void ParallelTrainer::merge(int worker) {
+        ValueNetwork& local = *models[worker]->value_network;
+        ValueNetwork& base = *bases[worker];
+        ValueNetwork& shared = *model->value_network;
+        std::lock_guard<std::mutex> lock(merge_mutex);
+        shared.add_difference(local, base);
+        local.copy(shared);
+        base.copy(shared);
+    }
+}
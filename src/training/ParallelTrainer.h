@@ -0,0 +1,61 @@
+#ifndef PARALLEL_TRAINER_H
+#define PARALLEL_TRAINER_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+#include "../game/Game.h"
+#include "../model/Model.h"
+
+namespace Backgammon {
+    /*
+        HOGWILD workers step the weights of the shared model directly, without locks.
+        BUFFERED workers step a copy of them, and every merge_frequency games 
+        add what they changed to the shared weights and take the result as their new copy.
+        The changes of all workers since their last merge add up, 
+        so a large merge_frequency can overshoot early in training
+    */
+    enum class Sharing {
+        HOGWILD,
+        BUFFERED
+    };
+
+    /*
+        Trains one ANALYTIC model with self-play games on several threads.
+        Every worker has its own Model for the buffers of choose_move and update, 
+        and its own Game, game i is played with dice stream i of dice_seed whatever thread plays it
+    */
+    class ParallelTrainer {
+    public:
+        std::shared_ptr<Model> model;
+        int threads;
+        Sharing sharing;
+        int merge_frequency;
+        uint64_t dice_seed;
+        std::vector<std::shared_ptr<Model>> models;
+        std::vector<std::unique_ptr<ValueNetwork>> bases; // shared weights at the last merge, for BUFFERED
+        std::vector<std::unique_ptr<Game>> games;
+        std::mutex merge_mutex;
+        std::atomic<int> next_game;
+        std::atomic<long long> moves;
+        ParallelTrainer(
+            std::shared_ptr<Model> model, 
+            int threads, 
+            uint64_t dice_seed, 
+            Sharing sharing = Sharing::HOGWILD, 
+            int merge_frequency = 4
+        );
+        /*
+            Plays games first to last - 1 and returns when all are done,
+            the weights of model are up to date then
+            @return number of moves made in them
+        */
+        long long train(int first, int last);
+        void work(int worker, int last);
+        void merge(int worker);
+    };
+}
+
+#endif
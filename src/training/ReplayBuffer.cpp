@@ -0,0 +1,110 @@
+#include "ReplayBuffer.h"
+
+namespace Backgammon {
+    ReplayBuffer::ReplayBuffer(int capacity, int features) 
+        : capacity(capacity),
+          features(features),
+          positions(capacity * features),
+          nexts(capacity * features),
+          rewards(capacity),
+          terminal(capacity)
+    {
+        assert(capacity > 0);
+    }
+
+    float* ReplayBuffer::position_slot() {
+        return positions.data() + next * features;
+    }
+
+    float* ReplayBuffer::next_slot() {
+        return nexts.data() + next * features;
+    }
+
+    void ReplayBuffer::push(bool game_over, float reward) {
+        terminal[next] = game_over;
+        rewards[next] = reward;
+        next = (next + 1) % capacity;
+        size = std::min(size + 1, capacity);
+    }
+
+    void ReplayBuffer::sample(
+        int n, 
+        RevGrad::Random& rng, 
+        float* x, 
+        float* x_next, 
+        float* sample_rewards, 
+        uint8_t* sample_terminal
+    ) const {
+        assert(size > 0);
+        for (int i = 0; i < n; i++) {
+            int entry = rng.uniform(size);
+            const float* row = positions.data() + entry * features;
+            const float* next_row = nexts.data() + entry * features;
+            for (int k = 0; k < features; k++) {
+                x[k * n + i] = row[k];
+                x_next[k * n + i] = next_row[k];
+            }
+            sample_rewards[i] = rewards[entry];
+            sample_terminal[i] = terminal[entry];
+        }
+    }
+
+    ReplayTrainer::ReplayTrainer(
+        std::string name, 
+        std::shared_ptr<Model> model, 
+        std::shared_ptr<ReplayBuffer> buffer, 
+        int batch_size, 
+        int step_frequency, 
+        uint64_t seed
+    ) 
+        : name(name),
+          model(model),
+          buffer(buffer),
+          batch_size(batch_size),
+          step_frequency(step_frequency),
+          rng(seed),
+          x(buffer->features * batch_size),
+          x_next(buffer->features * batch_size),
+          rewards(batch_size),
+          terminal(batch_size),
+          targets(batch_size)
+    {
+        assert(batch_size > 0 && step_frequency > 0);
+    }
+
+    int ReplayTrainer::choose_move(const Position& position, const Dice& dice, const AfterstateList& afterstates) {
+        int index = model->choose_move(position, dice, afterstates);
+        assert(index < afterstates.size);
+        const Position& next = afterstates[index].position;
+        float reward = 0.0f;
+        bool game_over = Model::game_over(next, reward);
+        model->encode(position, buffer->position_slot(), 1);
+        model->encode(next, buffer->next_slot(), 1);
+        buffer->push(game_over, reward);
+        if (++moves % step_frequency == 0 && buffer->size >= batch_size) {
+            step();
+        }
+        return index;
+    }
+
+    /*
+        The targets are the rewards of the moves that end a game 
+        and the current values of the positions reached otherwise
+    */
+    void ReplayTrainer::step() {
+        buffer->sample(batch_size, rng, x.data(), x_next.data(), rewards.data(), terminal.data());
+        model->evaluate(x_next.data(), batch_size, targets.data());
+        for (int i = 0; i < batch_size; i++) {
+            if (terminal[i]) {
+                targets[i] = rewards[i];
+            }
+        }
+        model->update(x.data(), targets.data(), batch_size, step_size);
+    }
+
+    void ReplayTrainer::new_game() {}
+
+    void ReplayTrainer::no_moves(const Position& position) {}
+    
+    void ReplayTrainer::game_over(const Position& position, int player) {}
+}
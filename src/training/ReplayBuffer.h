@@ -0,0 +1,90 @@
+#ifndef REPLAY_BUFFER_H
+#define REPLAY_BUFFER_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cassert>
+
+#include "../game/Game.h"
+#include "../model/Model.h"
+#include "../RevGrad/utill/Random.h"
+
+namespace Backgammon {
+    /*
+        Ring buffer of moves: the encoded position moved from and the encoded position reached,
+        with the reward if the game ended there. The TD target is bootstrapped from the
+        position reached when the move is sampled, so it follows the current weights.
+        Once full the oldest move is overwritten
+    */
+    class ReplayBuffer {
+    public:
+        int capacity;
+        int features;
+        int size = 0;
+        int next = 0; // entry written by the next push
+        std::vector<float> positions; // capacity x features, one position per row
+        std::vector<float> nexts;     // capacity x features
+        std::vector<float> rewards;
+        std::vector<uint8_t> terminal;
+        ReplayBuffer(int capacity, int features);
+        /*
+            @return the rows the next push writes, for encoding in place
+        */
+        float* position_slot();
+        float* next_slot();
+        /*
+            Adds the move encoded in the slots
+        */
+        void push(bool game_over, float reward);
+        /*
+            Draws n moves with replacement, x and x_next are features x n with one column per move
+        */
+        void sample(
+            int n, 
+            RevGrad::Random& rng, 
+            float* x, 
+            float* x_next, 
+            float* sample_rewards, 
+            uint8_t* sample_terminal
+        ) const;
+    };
+
+    /*
+        Plays like an AI and stores every move it makes in buffer.
+        Every step_frequency moves, once the buffer holds batch_size of them, 
+        the model takes one update on a batch sampled from it.
+        The step is on the mean over the batch, so it is larger than the alpha of a single move
+    */
+    class ReplayTrainer : public Player {
+    public:
+        std::string name;
+        std::shared_ptr<Model> model;
+        std::shared_ptr<ReplayBuffer> buffer; // can be shared by both players
+        int batch_size;
+        int step_frequency;
+        float step_size = 2.0f;
+        RevGrad::Random rng;
+        int moves = 0;
+        std::vector<float> x;
+        std::vector<float> x_next;
+        std::vector<float> rewards;
+        std::vector<uint8_t> terminal;
+        std::vector<float> targets;
+        ReplayTrainer(
+            std::string name, 
+            std::shared_ptr<Model> model, 
+            std::shared_ptr<ReplayBuffer> buffer, 
+            int batch_size = 32, 
+            int step_frequency = 8, 
+            uint64_t seed = 0
+        );
+        int choose_move(const Position& position, const Dice& dice, const AfterstateList& afterstates);
+        void step();
+        void new_game();
+        void no_moves(const Position& position);
+        void game_over(const Position& position, int player);
+    };
+}
+
+#endif